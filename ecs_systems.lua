@@ -0,0 +1,8 @@
+function MoveSystem(e, vel)
+	local pos = e:GetComponent "Position"
+	if pos then
+		pos.x = pos.x + vel.x
+		pos.y = pos.y + vel.y
+		pos.z = pos.z + vel.z
+	end
+end
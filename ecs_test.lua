@@ -26,3 +26,22 @@ for i=0,16 do
 	if i % 3 ~= 0 then e:AddComponent("Velocity") end
 end
 
+
+for i=0,16,4 do
+	local e = ecs.CreateEntity()
+	local pos = e:AddComponent "Position"
+	pos.x, pos.y, pos.z = i, i * 2, i * 3
+	local vel = e:AddComponent "Velocity"
+	vel.x = 1
+end
+
+for e, vel in ecs.Each "Velocity" do
+	local pos = e:GetComponent "Position"
+	if pos then
+		pos.x = pos.x + vel.x
+	end
+end
+
+for e, money in ecs.Each "Money" do
+	money:Add(5)
+end
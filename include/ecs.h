@@ -6,9 +6,19 @@ typedef struct ecs_id_t ecs_id_t; /* entity and component id */
 typedef struct ecs_ss_t ecs_ss_t; /* sparse set */
 typedef struct ecs_ss_slot_t ecs_ss_slot_t; /* sparse set slot */
 typedef struct ecs_registry_t ecs_registry_t; /* regsitry */
+typedef struct ecs_resource_t ecs_resource_t; /* singleton resource handle */
+typedef struct ecs_snapshot_t ecs_snapshot_t; /* ring of registry snapshots */
+typedef struct ecs_prefab_t ecs_prefab_t; /* entity template */
+typedef struct ecs_spatial_t ecs_spatial_t; /* spatial index over a position component */
+typedef struct ecs_events_t ecs_events_t; /* double-buffered event channel */
 typedef enum ecs_result_t ecs_result_t;
+typedef enum ecs_ss_flags_t ecs_ss_flags_t;
 typedef void (*pfn_ecs_iter_component_func)(ecs_registry_t* reg, ecs_id_t entity, void* comp);
 typedef void (*pfn_ecs_iter_func)(ecs_registry_t* reg, ecs_id_t entity, uint32_t ncomps, ecs_id_t* compids);
+typedef int (*pfn_ecs_ss_compare_func)(const void* lhs, const void* rhs);
+typedef uint32_t (*pfn_ecs_ss_key_func)(const void* slot);
+typedef void (*pfn_ecs_ss_hook_func)(void* data, ecs_id_t entity);
+typedef void (*pfn_ecs_ss_reset_func)(void* data);
 
 enum ecs_result_t {
 	ECS_ERROR = -1,
@@ -19,11 +29,19 @@ enum ecs_result_t {
 	ECS_NOT_FOUND,
 };
 
+enum ecs_ss_flags_t {
+	ECS_SS_NONE = 0,
+	ECS_SS_STABLE = 1 << 0, /* erase leaves a hole instead of swapping the last slot in */
+	ECS_SS_TRANSIENT = 1 << 1, /* emptied by ecs_clear_transient at the end of every frame */
+	ECS_SS_CONCURRENT = 1 << 2, /* accepts ecs_ss_emplace_concurrent from several threads */
+};
+
 #define ECS_NULL ((uint32_t)(-1))
 #define ECS_NULL_ID ((ecs_id_t) { (uint32_t)(-1) })
 
 struct ecs_id_t { uint32_t id; };
 struct ecs_ss_slot_t { void* data; };
+struct ecs_resource_t { uint32_t offset; };
 
 ecs_ss_t* 		ecs_ss_create(uint32_t slot_size, uint32_t sparse_size, uint32_t dense_size);
 void 			ecs_ss_destroy(ecs_ss_t* ss);
@@ -35,22 +53,97 @@ int 			ecs_ss_emplace(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t* pslot);
 int 			ecs_ss_insert(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t slot);
 int 			ecs_ss_erase(ecs_ss_t* ss, ecs_id_t entity_id);
 int 			ecs_ss_pop(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t slot);
+int 			ecs_ss_reserve(ecs_ss_t* ss, uint32_t sparse_size, uint32_t dense_size);
+int 			ecs_ss_emplace_n(ecs_ss_t* ss, const ecs_id_t* entity_ids, uint32_t count, const void* src, uint32_t src_stride);
+/* Thread-safe against itself only; the pool must be reserved up front since it never grows */
+int 			ecs_ss_emplace_concurrent(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t* pslot);
+int 			ecs_ss_erase_n(ecs_ss_t* ss, const ecs_id_t* entity_ids, uint32_t count);
+int 			ecs_ss_set_stable(ecs_ss_t* ss, bool stable, uint32_t max_holes);
+int 			ecs_ss_compact(ecs_ss_t* ss);
+int 			ecs_ss_clear(ecs_ss_t* ss);
+int 			ecs_ss_set_transient(ecs_ss_t* ss, bool transient);
+int 			ecs_ss_set_concurrent(ecs_ss_t* ss, bool concurrent);
+/* on_reset is called instead of per-entity hooks when the whole pool is rewritten (ecs_snapshot_restore) */
+int 			ecs_ss_set_hooks(ecs_ss_t* ss, pfn_ecs_ss_hook_func on_emplace, pfn_ecs_ss_hook_func on_erase, pfn_ecs_ss_reset_func on_reset, void* data);
 
 ecs_id_t 		ecs_ss_getid(ecs_ss_t* ss, uint32_t idx);
 ecs_ss_slot_t  	ecs_ss_getslot(ecs_ss_t* ss, uint32_t idx);
+uint32_t 		ecs_ss_count(ecs_ss_t* ss); /* slots in use, including holes of a stable pool */
+
+int 			ecs_ss_sort(ecs_ss_t* ss, pfn_ecs_ss_compare_func compare);
+int 			ecs_ss_sort_radix(ecs_ss_t* ss, pfn_ecs_ss_key_func key);
+int 			ecs_ss_sort_as(ecs_ss_t* ss, ecs_ss_t* ref);
 
 ecs_registry_t* ecs_init();
 void 			ecs_cleanup(ecs_registry_t* reg);
 bool 			ecs_register_component(ecs_registry_t* reg, uint32_t component_size, ecs_id_t component_id, uint32_t init_count);
+/* Resources live in one block owned by the registry. Handles stay valid for the registry's
+ * lifetime; pointers from ecs_resource_ptr only until the next resource is registered. */
+bool 			ecs_register_resource(ecs_registry_t* reg, uint32_t resource_size, ecs_id_t resource_id, const void* init);
+ecs_resource_t 	ecs_resource_handle(ecs_registry_t* reg, ecs_id_t resource_id);
+void* 			ecs_resource_ptr(ecs_registry_t* reg, ecs_resource_t handle);
+void* 			ecs_get_resource(ecs_registry_t* reg, ecs_id_t resource_id);
 ecs_ss_t*		ecs_component_storage(ecs_registry_t* reg, ecs_id_t component_id);
 uint32_t 		ecs_component_size(ecs_registry_t* reg, ecs_id_t component_id);
 ecs_id_t 		ecs_new_entity(ecs_registry_t* reg);
+ecs_id_t 		ecs_new_entity_range(ecs_registry_t* reg, uint32_t count);
 void* 			ecs_add_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id);
+/* Entity creation is always thread-safe. Concurrent adds need a pool flagged ECS_SS_CONCURRENT
+ * and reserved with ecs_reserve_component, and must not overlap other changes to that pool. */
+void* 			ecs_add_component_concurrent(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id);
+bool 			ecs_reserve_component(ecs_registry_t* reg, ecs_id_t component_id, uint32_t entity_count, uint32_t count);
 bool 			ecs_has_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id);
 void* 			ecs_get_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id);
+
+/* Bulk variants: src == NULL zero-fills, src_stride == 0 repeats *src for every entity */
+int 			ecs_add_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id, const void* src, uint32_t src_stride);
+int 			ecs_add_component_range(ecs_registry_t* reg, ecs_id_t first, uint32_t count, ecs_id_t component_id, const void* src, uint32_t src_stride);
+int 			ecs_remove_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id);
+int 			ecs_remove_component_range(ecs_registry_t* reg, ecs_id_t first, uint32_t count, ecs_id_t component_id);
+uint32_t 		ecs_get_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id, void** out);
+
+void 			ecs_compact(ecs_registry_t* reg);
+void 			ecs_clear_transient(ecs_registry_t* reg);
 void 			ecs_iter_component(ecs_registry_t* reg, ecs_id_t component_id, pfn_ecs_iter_component_func callback);
 void 			ecs_system(ecs_registry_t* reg, pfn_ecs_iter_func func, uint32_t ncomps, ...);
 
+ecs_prefab_t* 	ecs_prefab_create(ecs_registry_t* reg);
+void 			ecs_prefab_destroy(ecs_prefab_t* prefab);
+int 			ecs_prefab_set_component(ecs_prefab_t* prefab, ecs_id_t component_id, const void* value);
+ecs_id_t 		ecs_prefab_instantiate(ecs_prefab_t* prefab, uint32_t count);
+
+/* Moves a batch of entities and all their components from src to dst. Pools the batch needs are
+ * created in dst with the source pool's flags. Entity i becomes first + i in dst; returns first,
+ * or ECS_NULL_ID on failure, in which case neither registry's pools are changed. Fails for an empty
+ * batch, repeated ids or ids src never created. */
+ecs_id_t 		ecs_migrate_entities(ecs_registry_t* dst, ecs_registry_t* src, const ecs_id_t* entity_ids, uint32_t count);
+
+/* Positions are float[3] at `offset` in the component. Call ecs_spatial_touch after moving
+ * an entity and ecs_spatial_update once positions are written, before querying. */
+ecs_spatial_t* 	ecs_spatial_create(ecs_registry_t* reg, ecs_id_t component_id, uint32_t offset, float cell_size);
+void 			ecs_spatial_destroy(ecs_spatial_t* sp);
+void 			ecs_spatial_touch(ecs_spatial_t* sp, ecs_id_t entity);
+void 			ecs_spatial_update(ecs_spatial_t* sp);
+void 			ecs_spatial_rebuild(ecs_spatial_t* sp);
+uint32_t 		ecs_spatial_query_box(ecs_spatial_t* sp, const float min[3], const float max[3], ecs_id_t* out, uint32_t max_out);
+uint32_t 		ecs_spatial_query_radius(ecs_spatial_t* sp, const float center[3], float radius, ecs_id_t* out, uint32_t max_out);
+uint32_t 		ecs_spatial_query_nearest(ecs_spatial_t* sp, const float center[3], uint32_t k, ecs_id_t* out);
+
+/* Emitting is lock-free and may happen from any thread. Reads return the events emitted
+ * before the last ecs_swap_events, which must run while no thread is emitting. */
+bool 			ecs_register_event(ecs_registry_t* reg, uint32_t event_size, ecs_id_t event_id, uint32_t capacity);
+ecs_events_t* 	ecs_event_channel(ecs_registry_t* reg, ecs_id_t event_id);
+void* 			ecs_events_emit(ecs_events_t* ch, uint32_t count);
+bool 			ecs_events_send(ecs_events_t* ch, const void* event);
+const void* 	ecs_events_read(ecs_events_t* ch, uint32_t* count);
+void 			ecs_swap_events(ecs_registry_t* reg);
+
+ecs_snapshot_t* ecs_snapshot_create(ecs_registry_t* reg, uint32_t frame_count);
+void 			ecs_snapshot_destroy(ecs_snapshot_t* snap);
+uint32_t 		ecs_snapshot_count(ecs_snapshot_t* snap);
+int 			ecs_snapshot_save(ecs_snapshot_t* snap);
+int 			ecs_snapshot_restore(ecs_snapshot_t* snap, uint32_t frames_back);
+
 #define ecs_id(id)  ((ecs_id_t) { id })
 
 /*     Hashing     */
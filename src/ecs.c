@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
+#include <math.h>
 
 #if ECS_DEBUG
 #	define ecs_debugf(fmt, ...) DEBUG_CHANNEL(ecs, fmt, ##__VA_ARGS__)
@@ -34,20 +35,38 @@ struct ecs_ss_t {
 	uint32_t 	sparse_size; 	// reserved count in sparse array
 	uint32_t 	dense_size;		// reserved count in dense array
 	uint32_t 	slot_size;		// byte size of each slot
-	uint32_t 	slot_count; 	// no. of slots in use
+	uint32_t 	slot_count; 	// no. of slots in use, including holes
+	uint32_t 	flags;			// ecs_ss_flags_t
+	uint32_t 	hole_count;		// no. of erased slots awaiting reuse (ECS_SS_STABLE)
+	uint32_t 	max_holes;		// hole count past which ecs_compact compacts the pool
 	uint32_t* 	sparse;			// sparse array of indices
-	ecs_id_t* 	dense_ids;		// dense array of ids
+	ecs_id_t* 	dense_ids;		// dense array of ids, ECS_NULL_ID marks a hole
 	void* 		dense_slots;	// dense array of slots
+	uint32_t* 	holes;			// free list of hole indices, reserved to dense_size
+	pfn_ecs_ss_hook_func on_emplace;	// called after an entity joins the pool
+	pfn_ecs_ss_hook_func on_erase;		// called after an entity leaves the pool
+	pfn_ecs_ss_reset_func on_reset;		// called after the whole pool is rewritten
+	void* 		hook_data;
 };
 
+#define ecs_ss_notify(ss, hook, entity_id) do { if ((ss)->hook) (ss)->hook((ss)->hook_data, (entity_id)); } while (0)
+
 void ecs_ss_create_ex(ecs_ss_t* ss, uint32_t slot_size, uint32_t sparse_size, uint32_t dense_size) {
 	ss->sparse_size = sparse_size;
 	ss->dense_size = dense_size;
 	ss->slot_size = slot_size;
 	ss->slot_count = 0;
+	ss->flags = ECS_SS_NONE;
+	ss->hole_count = 0;
+	ss->max_holes = 0;
 	ss->sparse = malloc(sizeof(uint32_t) * sparse_size);
 	ss->dense_ids = malloc(sizeof(ecs_id_t) * dense_size);
 	ss->dense_slots = malloc(slot_size * dense_size);
+	ss->holes = NULL;
+	ss->on_emplace = NULL;
+	ss->on_erase = NULL;
+	ss->on_reset = NULL;
+	ss->hook_data = NULL;
 	memset(ss->sparse, -1, sizeof(uint32_t) * sparse_size);
 }
 
@@ -61,15 +80,23 @@ void ecs_ss_destroy(ecs_ss_t* ss) {
 	free(ss->sparse);
 	free(ss->dense_ids);
 	free(ss->dense_slots);
+	free(ss->holes);
 	free(ss);
 }
 
+// a sparse entry only counts if the dense side points back at it, so the stale entries
+// left behind by ecs_ss_clear never need to be reset
+static inline uint32_t ecs_ss_lookup(ecs_ss_t* ss, ecs_id_t entity_id) {
+	uint32_t index = ss->sparse[entity_id.id];
+	return (index < ss->slot_count && ss->dense_ids[index].id == entity_id.id) ? index : ECS_NULL;
+}
+
 bool ecs_ss_has(ecs_ss_t* ss, ecs_id_t entity_id) {
 	if (entity_id.id >= ss->sparse_size) {
 		return false;
 	}
 	uint32_t index;
-	index = ss->sparse[entity_id.id];
+	index = ecs_ss_lookup(ss, entity_id);
 	return ECS_NULL != index;
 }
 
@@ -82,7 +109,7 @@ ecs_ss_slot_t ecs_ss_get(ecs_ss_t* ss, ecs_id_t entity_id) {
 		return slot;
 	}
 	uint32_t index;
-	index = ss->sparse[entity_id.id];
+	index = ecs_ss_lookup(ss, entity_id);
 	if (ECS_NULL == index) {
 		ecs_debugf("not found");
 		return slot;
@@ -97,19 +124,25 @@ int ecs_ss_emplace(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t* pslot) {
 		return ECS_INVALID_ARG;
 	}
 	uint32_t index;
-	index = ss->sparse[entity_id.id];
+	index = ecs_ss_lookup(ss, entity_id);
 	if (ECS_NULL != index) {
 		assert(ss->dense_ids[index].id == entity_id.id);
 		pslot->data = ecs_ss_slotbyidx(ss, index);
 		return ECS_FOUND;
 	}
-	if (ss->slot_count >= ss->dense_size) {
+	if (ss->hole_count > 0) {
+		index = ss->holes[--ss->hole_count];
+	}
+	else if (ss->slot_count >= ss->dense_size) {
 		return ECS_OUT_OF_MEMORY;
 	}
-	index = ss->slot_count++;
+	else {
+		index = ss->slot_count++;
+	}
 	ss->sparse[entity_id.id] = index;
 	ss->dense_ids[index] = entity_id;
 	pslot->data = ecs_ss_slotbyidx(ss, index);
+	ecs_ss_notify(ss, on_emplace, entity_id);
 	return ECS_OK;
 }
 
@@ -130,17 +163,31 @@ int ecs_ss_pop(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t slot) {
 		return ECS_INVALID_ARG;
 	}
 	uint32_t index;
-	index = ss->sparse[entity_id.id];
+	index = ecs_ss_lookup(ss, entity_id);
 	if (ECS_NULL == index) {
 		return ECS_NOT_FOUND;
 	}
 	ss->sparse[entity_id.id] = ECS_NULL;
+	if (ss->flags & ECS_SS_STABLE) {
+		// leave every other slot where it is, the hole is reused by the next emplace
+		if (slot.data) memcpy(slot.data, ecs_ss_slotbyidx(ss, index), ss->slot_size);
+		ss->dense_ids[index] = ECS_NULL_ID;
+		ss->holes[ss->hole_count++] = index;
+		ecs_ss_notify(ss, on_erase, entity_id);
+		return ECS_OK;
+	}
 	uint32_t lastindex = --ss->slot_count;
-	ecs_id_t lastid = ss->dense_ids[lastindex];
-	ss->dense_ids[index] = lastid;
-	ss->sparse[lastid.id] = index;
 	if (slot.data) memcpy(slot.data, ecs_ss_slotbyidx(ss, index), ss->slot_size);
-	memcpy(ecs_ss_slotbyidx(ss, index), ecs_ss_slotbyidx(ss, lastindex), ss->slot_size);
+	if (index != lastindex) {
+		ecs_id_t lastid = ss->dense_ids[lastindex];
+		ss->dense_ids[index] = lastid;
+		ss->sparse[lastid.id] = index;
+		memcpy(ecs_ss_slotbyidx(ss, index), ecs_ss_slotbyidx(ss, lastindex), ss->slot_size);
+	}
+	if (ss->flags & ECS_SS_CONCURRENT) {
+		ss->dense_ids[lastindex] = ECS_NULL_ID; // keep the tail free of stale ids
+	}
+	ecs_ss_notify(ss, on_erase, entity_id);
 	return ECS_OK;
 }
 
@@ -154,14 +201,450 @@ ecs_ss_slot_t ecs_ss_getslot(ecs_ss_t* ss, uint32_t idx)
 	return (ecs_ss_slot_t) { ecs_ss_slotbyidx(ss, idx) };
 }
 
+uint32_t ecs_ss_count(ecs_ss_t* ss)
+{
+	return ss->slot_count;
+}
+
+int ecs_ss_reserve(ecs_ss_t* ss, uint32_t sparse_size, uint32_t dense_size) {
+	if (sparse_size > ss->sparse_size) {
+		uint32_t* sparse = realloc(ss->sparse, sizeof(uint32_t) * sparse_size);
+		if (!sparse) {
+			return ECS_OUT_OF_MEMORY;
+		}
+		memset(sparse + ss->sparse_size, -1, sizeof(uint32_t) * (sparse_size - ss->sparse_size));
+		ss->sparse = sparse;
+		ss->sparse_size = sparse_size;
+	}
+	if (dense_size > ss->dense_size) {
+		ecs_id_t* dense_ids = realloc(ss->dense_ids, sizeof(ecs_id_t) * dense_size);
+		if (!dense_ids) {
+			return ECS_OUT_OF_MEMORY;
+		}
+		memset(dense_ids + ss->dense_size, -1, sizeof(ecs_id_t) * (dense_size - ss->dense_size));
+		ss->dense_ids = dense_ids;
+		void* dense_slots = realloc(ss->dense_slots, (size_t)ss->slot_size * dense_size);
+		if (!dense_slots) {
+			return ECS_OUT_OF_MEMORY;
+		}
+		ss->dense_slots = dense_slots;
+		if (ss->holes) {
+			uint32_t* holes = realloc(ss->holes, sizeof(uint32_t) * dense_size);
+			if (!holes) {
+				return ECS_OUT_OF_MEMORY;
+			}
+			ss->holes = holes;
+		}
+		ss->dense_size = dense_size;
+	}
+	return ECS_OK;
+}
+
+int ecs_ss_clear(ecs_ss_t* ss) {
+	if (ss->on_erase) {
+		for (uint32_t i = 0; i < ss->slot_count; i++) {
+			ecs_id_t id = ss->dense_ids[i];
+			if (ECS_NULL == id.id) continue;
+			ss->sparse[id.id] = ECS_NULL;
+			ss->on_erase(ss->hook_data, id);
+		}
+	}
+	// sparse is left as is, ecs_ss_lookup rejects every entry once slot_count is 0
+	if (ss->flags & ECS_SS_CONCURRENT) {
+		// ...but a concurrent emplace may reserve a slot before writing its id, keep the old ids out of it
+		memset(ss->dense_ids, -1, sizeof(ecs_id_t) * ss->slot_count);
+	}
+	ss->slot_count = 0;
+	ss->hole_count = 0;
+	return ECS_OK;
+}
+
+int ecs_ss_set_transient(ecs_ss_t* ss, bool transient) {
+	if (transient) ss->flags |= ECS_SS_TRANSIENT;
+	else ss->flags &= ~ECS_SS_TRANSIENT;
+	return ECS_OK;
+}
+
+int ecs_ss_set_concurrent(ecs_ss_t* ss, bool concurrent) {
+	if (concurrent) {
+		// no stale id may sit past slot_count, see ecs_ss_emplace_concurrent
+		memset(ss->dense_ids + ss->slot_count, -1, sizeof(ecs_id_t) * (ss->dense_size - ss->slot_count));
+		ss->flags |= ECS_SS_CONCURRENT;
+	}
+	else {
+		ss->flags &= ~ECS_SS_CONCURRENT;
+	}
+	return ECS_OK;
+}
+
+int ecs_ss_set_hooks(ecs_ss_t* ss, pfn_ecs_ss_hook_func on_emplace, pfn_ecs_ss_hook_func on_erase, pfn_ecs_ss_reset_func on_reset, void* data) {
+	if ((on_emplace || on_erase || on_reset) && (ss->on_emplace || ss->on_erase || ss->on_reset)) {
+		return ECS_FOUND; // one listener per pool
+	}
+	ss->on_emplace = on_emplace;
+	ss->on_erase = on_erase;
+	ss->on_reset = on_reset;
+	ss->hook_data = data;
+	return ECS_OK;
+}
+
+int ecs_ss_compact(ecs_ss_t* ss) {
+	if (ss->hole_count == 0) {
+		return ECS_OK;
+	}
+	// slide each run of live slots down over the holes, keeping iteration order
+	uint32_t dst = 0;
+	uint32_t i = 0;
+	while (i < ss->slot_count) {
+		while (i < ss->slot_count && ECS_NULL == ss->dense_ids[i].id) i++;
+		uint32_t start = i;
+		while (i < ss->slot_count && ECS_NULL != ss->dense_ids[i].id) i++;
+		uint32_t len = i - start;
+		if (dst != start && len > 0) {
+			memmove(&ss->dense_ids[dst], &ss->dense_ids[start], sizeof(ecs_id_t) * len);
+			memmove(ecs_ss_slotbyidx(ss, dst), ecs_ss_slotbyidx(ss, start), (size_t)ss->slot_size * len);
+			for (uint32_t k = dst; k < dst + len; k++) {
+				ss->sparse[ss->dense_ids[k].id] = k;
+			}
+		}
+		dst += len;
+	}
+	ecs_debugf("compacted %u holes", ss->slot_count - dst);
+	ss->slot_count = dst;
+	ss->hole_count = 0;
+	return ECS_OK;
+}
+
+int ecs_ss_set_stable(ecs_ss_t* ss, bool stable, uint32_t max_holes) {
+	if (!stable) {
+		ecs_ss_compact(ss);
+		free(ss->holes);
+		ss->holes = NULL;
+		ss->flags &= ~ECS_SS_STABLE;
+		return ECS_OK;
+	}
+	if (!ss->holes) {
+		ss->holes = malloc(sizeof(uint32_t) * ss->dense_size);
+		if (!ss->holes) {
+			return ECS_OUT_OF_MEMORY;
+		}
+	}
+	ss->flags |= ECS_SS_STABLE;
+	ss->max_holes = max_holes;
+	return ECS_OK;
+}
+
+// ids == NULL addresses the contiguous range [first, first + count)
+#define ecs_ids_at(ids, first, i) ((ids) ? (ids)[i] : ecs_id((first).id + (i)))
+
+static int ecs_ss_emplace_ex(ecs_ss_t* ss, const ecs_id_t* entity_ids, ecs_id_t first, uint32_t count, const void* src, uint32_t copy_size, uint32_t src_stride) {
+	if (count == 0) {
+		return ECS_OK;
+	}
+	uint32_t max_id = 0;
+	if (entity_ids) {
+		for (uint32_t i = 0; i < count; i++) {
+			if (entity_ids[i].id > max_id) max_id = entity_ids[i].id;
+		}
+	}
+	else {
+		max_id = first.id + count - 1;
+	}
+	if (max_id == ECS_NULL) {
+		return ECS_INVALID_ARG;
+	}
+	uint32_t sparse_size = ss->sparse_size;
+	uint32_t dense_size = ss->dense_size;
+	if (max_id >= sparse_size) {
+		sparse_size = (max_id + 1 > 2 * sparse_size) ? max_id + 1 : 2 * sparse_size;
+	}
+	// holes are filled first, only what they can't take grows the dense arrays (and moves stable slots)
+	uint32_t appended = (count > ss->hole_count) ? count - ss->hole_count : 0;
+	if (ss->slot_count + appended > dense_size) {
+		dense_size = (ss->slot_count + appended > 2 * dense_size) ? ss->slot_count + appended : 2 * dense_size;
+	}
+	int res = ecs_ss_reserve(ss, sparse_size, dense_size);
+	if (ECS_OK != res) {
+		return res;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		ecs_id_t id = ecs_ids_at(entity_ids, first, i);
+		if (ECS_NULL != ecs_ss_lookup(ss, id)) {
+			continue;
+		}
+		uint32_t index = (ss->hole_count > 0) ? ss->holes[--ss->hole_count] : ss->slot_count++;
+		ss->sparse[id.id] = index;
+		ss->dense_ids[index] = id;
+		uint8_t* dst = ecs_ss_slotbyidx(ss, index);
+		if (src) {
+			memcpy(dst, (const uint8_t*)src + (size_t)src_stride * i, copy_size);
+			memzero(dst + copy_size, ss->slot_size - copy_size);
+		}
+		else {
+			memzero(dst, ss->slot_size);
+		}
+		ecs_ss_notify(ss, on_emplace, id);
+	}
+	return ECS_OK;
+}
+
+int ecs_ss_emplace_n(ecs_ss_t* ss, const ecs_id_t* entity_ids, uint32_t count, const void* src, uint32_t src_stride) {
+	return ecs_ss_emplace_ex(ss, entity_ids, ECS_NULL_ID, count, src, ss->slot_size, src_stride);
+}
+
+/*
+ * Lock-free emplace for pools flagged ECS_SS_CONCURRENT. The entity's sparse
+ * entry is claimed with a CAS (ECS_SS_CLAIMED), a dense index is reserved with
+ * a CAS on slot_count, and the index is published to sparse with a release
+ * store. Other threads adding the same entity spin on the claim and get
+ * ECS_FOUND. Nothing is reallocated, so reserve the pool beforehand; holes are
+ * not reused and hooks are not supported. Must not overlap with any other
+ * mutation of the pool.
+ */
+#define ECS_SS_CLAIMED (ECS_NULL - 1)
+
+int ecs_ss_emplace_concurrent(ecs_ss_t* ss, ecs_id_t entity_id, ecs_ss_slot_t* pslot) {
+	if (!(ss->flags & ECS_SS_CONCURRENT) || ss->on_emplace || entity_id.id >= ss->sparse_size) {
+		return ECS_INVALID_ARG;
+	}
+	uint32_t* psparse = &ss->sparse[entity_id.id];
+	uint32_t index = __atomic_load_n(psparse, __ATOMIC_ACQUIRE);
+	for (;;) {
+		if (ECS_SS_CLAIMED == index) {
+			index = __atomic_load_n(psparse, __ATOMIC_ACQUIRE);
+			continue;
+		}
+		if (index < __atomic_load_n(&ss->slot_count, __ATOMIC_ACQUIRE)
+			&& __atomic_load_n(&ss->dense_ids[index].id, __ATOMIC_RELAXED) == entity_id.id) {
+			pslot->data = ecs_ss_slotbyidx(ss, index);
+			return ECS_FOUND;
+		}
+		if (__atomic_compare_exchange_n(psparse, &index, ECS_SS_CLAIMED, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+			break;
+		}
+	}
+	index = __atomic_load_n(&ss->slot_count, __ATOMIC_RELAXED);
+	do {
+		if (index >= ss->dense_size) {
+			__atomic_store_n(psparse, ECS_NULL, __ATOMIC_RELEASE);
+			return ECS_OUT_OF_MEMORY;
+		}
+	} while (!__atomic_compare_exchange_n(&ss->slot_count, &index, index + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	__atomic_store_n(&ss->dense_ids[index].id, entity_id.id, __ATOMIC_RELAXED);
+	__atomic_store_n(psparse, index, __ATOMIC_RELEASE);
+	pslot->data = ecs_ss_slotbyidx(ss, index);
+	return ECS_OK;
+}
+
+static int ecs_ss_erase_ex(ecs_ss_t* ss, const ecs_id_t* entity_ids, ecs_id_t first, uint32_t count) {
+	if (ss->flags & ECS_SS_STABLE) {
+		for (uint32_t i = 0; i < count; i++) {
+			ecs_ss_erase(ss, ecs_ids_at(entity_ids, first, i));
+		}
+		return ECS_OK;
+	}
+	uint32_t* holes = malloc(sizeof(uint32_t) * (count ? count : 1));
+	if (!holes) {
+		return ECS_OUT_OF_MEMORY;
+	}
+	// unlink everything first, then fill the holes below the new count from the tail in one pass
+	uint32_t removed = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		ecs_id_t id = ecs_ids_at(entity_ids, first, i);
+		if (id.id >= ss->sparse_size || ECS_NULL == ecs_ss_lookup(ss, id)) {
+			continue;
+		}
+		uint32_t index = ss->sparse[id.id];
+		ss->sparse[id.id] = ECS_NULL;
+		ss->dense_ids[index] = ECS_NULL_ID;
+		holes[removed++] = index;
+		ecs_ss_notify(ss, on_erase, id);
+	}
+	uint32_t new_count = ss->slot_count - removed;
+	uint32_t tail = ss->slot_count;
+	for (uint32_t i = 0; i < removed; i++) {
+		uint32_t hole = holes[i];
+		if (hole >= new_count) {
+			continue;
+		}
+		do { tail--; } while (ECS_NULL == ss->dense_ids[tail].id);
+		ecs_id_t id = ss->dense_ids[tail];
+		ss->dense_ids[hole] = id;
+		ss->sparse[id.id] = hole;
+		memcpy(ecs_ss_slotbyidx(ss, hole), ecs_ss_slotbyidx(ss, tail), ss->slot_size);
+		if (ss->flags & ECS_SS_CONCURRENT) {
+			ss->dense_ids[tail] = ECS_NULL_ID; // keep the tail free of stale ids
+		}
+	}
+	ss->slot_count = new_count;
+	free(holes);
+	return ECS_OK;
+}
+
+int ecs_ss_erase_n(ecs_ss_t* ss, const ecs_id_t* entity_ids, uint32_t count) {
+	return ecs_ss_erase_ex(ss, entity_ids, ECS_NULL_ID, count);
+}
+
+static void ecs_ss_swap(ecs_ss_t* ss, uint32_t lhs, uint32_t rhs) {
+	ecs_id_t lhs_id = ss->dense_ids[lhs];
+	ecs_id_t rhs_id = ss->dense_ids[rhs];
+	ss->dense_ids[lhs] = rhs_id;
+	ss->dense_ids[rhs] = lhs_id;
+	ss->sparse[lhs_id.id] = rhs;
+	ss->sparse[rhs_id.id] = lhs;
+	memswp(ecs_ss_slotbyidx(ss, lhs), ecs_ss_slotbyidx(ss, rhs), ss->slot_size);
+}
+
+static void ecs_ss_siftdown(ecs_ss_t* ss, pfn_ecs_ss_compare_func compare, uint32_t root, uint32_t count) {
+	for (uint32_t child = 2 * root + 1; child < count; child = 2 * root + 1) {
+		if (child + 1 < count && compare(ecs_ss_slotbyidx(ss, child), ecs_ss_slotbyidx(ss, child + 1)) < 0) {
+			child++;
+		}
+		if (compare(ecs_ss_slotbyidx(ss, root), ecs_ss_slotbyidx(ss, child)) >= 0) {
+			return;
+		}
+		ecs_ss_swap(ss, root, child);
+		root = child;
+	}
+}
+
+int ecs_ss_sort(ecs_ss_t* ss, pfn_ecs_ss_compare_func compare) {
+	if (!compare) {
+		return ECS_INVALID_ARG;
+	}
+	ecs_ss_compact(ss);
+	// heapsort, so the dense arrays are permuted in place without scratch memory
+	uint32_t count = ss->slot_count;
+	for (uint32_t i = count / 2; i-- > 0; ) {
+		ecs_ss_siftdown(ss, compare, i, count);
+	}
+	for (uint32_t end = count; end-- > 1; ) {
+		ecs_ss_swap(ss, 0, end);
+		ecs_ss_siftdown(ss, compare, 0, end);
+	}
+	return ECS_OK;
+}
+
+int ecs_ss_sort_radix(ecs_ss_t* ss, pfn_ecs_ss_key_func key) {
+	if (!key) {
+		return ECS_INVALID_ARG;
+	}
+	ecs_ss_compact(ss);
+	uint32_t count = ss->slot_count;
+	if (count < 2) {
+		return ECS_OK;
+	}
+	uint32_t* keys_buf = malloc(sizeof(uint32_t) * count * 2);
+	uint32_t* order_buf = malloc(sizeof(uint32_t) * count * 2);
+	uint8_t* tmpslot = malloc(ss->slot_size);
+	if (!keys_buf || !order_buf || !tmpslot) {
+		free(keys_buf); free(order_buf); free(tmpslot);
+		return ECS_OUT_OF_MEMORY;
+	}
+	uint32_t* keys = keys_buf;
+	uint32_t* keys_tmp = keys_buf + count;
+	uint32_t* order = order_buf;
+	uint32_t* order_tmp = order_buf + count;
+	for (uint32_t i = 0; i < count; i++) {
+		keys[i] = key(ecs_ss_slotbyidx(ss, i));
+		order[i] = i;
+	}
+	// lsd radix over 8-bit digits, stable so equal keys keep their relative order
+	for (uint32_t shift = 0; shift < 32; shift += 8) {
+		uint32_t offsets[256] = { 0 };
+		for (uint32_t i = 0; i < count; i++) {
+			offsets[(keys[i] >> shift) & 0xff]++;
+		}
+		if (offsets[(keys[0] >> shift) & 0xff] == count) {
+			continue; // every key shares this digit
+		}
+		for (uint32_t d = 0, sum = 0; d < 256; d++) {
+			uint32_t n = offsets[d];
+			offsets[d] = sum;
+			sum += n;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t dst = offsets[(keys[i] >> shift) & 0xff]++;
+			keys_tmp[dst] = keys[i];
+			order_tmp[dst] = order[i];
+		}
+		uint32_t* swp;
+		swp = keys; keys = keys_tmp; keys_tmp = swp;
+		swp = order; order = order_tmp; order_tmp = swp;
+	}
+	// apply the permutation by following cycles, order[i] is the old index that belongs at i
+	for (uint32_t i = 0; i < count; i++) {
+		if (order[i] == i || order[i] == ECS_NULL) {
+			continue;
+		}
+		ecs_id_t tmpid = ss->dense_ids[i];
+		memcpy(tmpslot, ecs_ss_slotbyidx(ss, i), ss->slot_size);
+		uint32_t dst = i;
+		uint32_t src = order[i];
+		while (src != i) {
+			ss->dense_ids[dst] = ss->dense_ids[src];
+			memcpy(ecs_ss_slotbyidx(ss, dst), ecs_ss_slotbyidx(ss, src), ss->slot_size);
+			order[dst] = ECS_NULL;
+			dst = src;
+			src = order[src];
+		}
+		ss->dense_ids[dst] = tmpid;
+		memcpy(ecs_ss_slotbyidx(ss, dst), tmpslot, ss->slot_size);
+		order[dst] = ECS_NULL;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		ss->sparse[ss->dense_ids[i].id] = i;
+	}
+	free(keys_buf);
+	free(order_buf);
+	free(tmpslot);
+	return ECS_OK;
+}
+
+int ecs_ss_sort_as(ecs_ss_t* ss, ecs_ss_t* ref) {
+	if (!ref || ref == ss) {
+		return ECS_INVALID_ARG;
+	}
+	ecs_ss_compact(ss);
+	// entities shared with ref move to the front in ref's order, the rest keep to the back
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < ref->slot_count && pos < ss->slot_count; i++) {
+		ecs_id_t id = ref->dense_ids[i];
+		if (!ecs_ss_has(ss, id)) {
+			continue;
+		}
+		uint32_t index = ss->sparse[id.id];
+		if (index != pos) {
+			ecs_ss_swap(ss, index, pos);
+		}
+		pos++;
+	}
+	return ECS_OK;
+}
+
 /********************************************************************
  * ECS Registry Implementation
  *******************************************************************/
 struct ecs_registry_t {
 	hashmap_t storage_map;
 	ecs_id_t      next_id;
+	hashmap_t resource_map;		// resource id -> ecs_resource_t
+	hashmap_t event_map;		// event id -> ecs_events_t*
+	uint8_t*  resources;		// contiguous block of every resource
+	uint32_t  resource_size;	// bytes in use in resources
+	uint32_t  resource_capacity;
 };
 
+#define ECS_RESOURCE_ALIGN 16
+
+#define ecs_foreach_pool(reg, idx, pcompid, pool) \
+	for (uint32_t idx = hashmap_iternext((reg)->storage_map, 0, (void**)&(pcompid), (void**)&(pool)); \
+		idx != ECS_NULL; \
+		idx = hashmap_iternext((reg)->storage_map, idx, (void**)&(pcompid), (void**)&(pool)))
+
+#define ecs_component_slot_size(component_size) ((uint32_t)sizeof(ecs_id_t) + (component_size))
+#define ecs_component_bytes(ss) ((ss)->slot_size - (uint32_t)sizeof(ecs_id_t))
+
 static uint64_t id_hash_func(hashmap_key_ptr pkey) {
 	return ((ecs_id_t*)pkey)->id;
 }
@@ -175,22 +658,80 @@ ecs_registry_t* ecs_init()
 	ecs_registry_t* reg = malloc(sizeof(ecs_registry_t));
 	reg->next_id.id = 0;
 	reg->storage_map = hashmap_create(sizeof(ecs_id_t), sizeof(ecs_ss_t), id_hash_func, id_keyeq_func, 200, &(ecs_id_t) { -1 });
+	reg->resource_map = hashmap_create(sizeof(ecs_id_t), sizeof(ecs_resource_t), id_hash_func, id_keyeq_func, 64, &(ecs_id_t) { -1 });
+	reg->resources = NULL;
+	reg->resource_size = 0;
+	reg->resource_capacity = 0;
+	reg->event_map = hashmap_create(sizeof(ecs_id_t), sizeof(ecs_events_t*), id_hash_func, id_keyeq_func, 64, &(ecs_id_t) { -1 });
 	return reg;
 }
 
+static void ecs_events_destroy(ecs_events_t* ch);
+
 void ecs_cleanup(ecs_registry_t* reg) {
+	ecs_id_t* pid; ecs_events_t** pch;
+	for (uint32_t idx = hashmap_iternext(reg->event_map, 0, (void**)&pid, (void**)&pch); idx != ECS_NULL; idx = hashmap_iternext(reg->event_map, idx, (void**)&pid, (void**)&pch)) {
+		ecs_events_destroy(*pch);
+	}
 	hashmap_destroy(reg->storage_map);
+	hashmap_destroy(reg->resource_map);
+	hashmap_destroy(reg->event_map);
+	free(reg->resources);
 }
 
 bool ecs_register_component(ecs_registry_t* reg, uint32_t component_size, ecs_id_t component_id, uint32_t init_count) {
+	if (hashmap_find(reg->resource_map, &component_id)) {
+		return false;
+	}
 	ecs_ss_t* storage = hashmap_emplace(reg->storage_map, &component_id);
 	if (storage) {
-		ecs_ss_create_ex(storage, sizeof(ecs_id_t) + component_size, init_count, 1024); // TODO: Handle resizing ids array
+		ecs_ss_create_ex(storage, ecs_component_slot_size(component_size), init_count, 1024); // TODO: Handle resizing ids array
 		return true;
 	}
 	return false;
 }
 
+bool ecs_register_resource(ecs_registry_t* reg, uint32_t resource_size, ecs_id_t resource_id, const void* init) {
+	if (hashmap_find(reg->storage_map, &resource_id) || hashmap_find(reg->resource_map, &resource_id)) {
+		return false;
+	}
+	uint32_t offset = (reg->resource_size + ECS_RESOURCE_ALIGN - 1) & ~(uint32_t)(ECS_RESOURCE_ALIGN - 1);
+	if (offset + resource_size > reg->resource_capacity) {
+		uint32_t capacity = reg->resource_capacity ? reg->resource_capacity : 256;
+		while (capacity < offset + resource_size) {
+			capacity *= 2;
+		}
+		uint8_t* resources = realloc(reg->resources, capacity);
+		if (!resources) {
+			return false;
+		}
+		reg->resources = resources;
+		reg->resource_capacity = capacity;
+	}
+	ecs_resource_t* handle = hashmap_emplace(reg->resource_map, &resource_id);
+	if (!handle) {
+		return false;
+	}
+	handle->offset = offset;
+	if (init) memcpy(reg->resources + offset, init, resource_size);
+	else memzero(reg->resources + offset, resource_size);
+	reg->resource_size = offset + resource_size;
+	return true;
+}
+
+ecs_resource_t ecs_resource_handle(ecs_registry_t* reg, ecs_id_t resource_id) {
+	ecs_resource_t* handle = hashmap_find(reg->resource_map, &resource_id);
+	return handle ? *handle : (ecs_resource_t) { ECS_NULL };
+}
+
+void* ecs_resource_ptr(ecs_registry_t* reg, ecs_resource_t handle) {
+	return (ECS_NULL == handle.offset) ? NULL : reg->resources + handle.offset;
+}
+
+void* ecs_get_resource(ecs_registry_t* reg, ecs_id_t resource_id) {
+	return ecs_resource_ptr(reg, ecs_resource_handle(reg, resource_id));
+}
+
 ecs_ss_t* ecs_component_storage(ecs_registry_t* reg, ecs_id_t component_id) {
 	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
 	return storage;
@@ -205,11 +746,22 @@ uint32_t ecs_component_size(ecs_registry_t* reg, ecs_id_t component_id) {
 }
 
 ecs_id_t ecs_new_entity(ecs_registry_t* reg) {
-	ecs_id_t id = { reg->next_id.id++ };
+	ecs_id_t id = { __atomic_fetch_add(&reg->next_id.id, 1, __ATOMIC_RELAXED) };
 	ecs_debugf("New entity: %u", id.id);
 	return id;
 }
 
+ecs_id_t ecs_new_entity_range(ecs_registry_t* reg, uint32_t count) {
+	ecs_id_t first = { __atomic_load_n(&reg->next_id.id, __ATOMIC_RELAXED) };
+	do {
+		if (count == 0 || count > ECS_NULL - first.id) {
+			return ECS_NULL_ID;
+		}
+	} while (!__atomic_compare_exchange_n(&reg->next_id.id, &first.id, first.id + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	ecs_debugf("New entities: %u..%u", first.id, first.id + count - 1);
+	return first;
+}
+
 void* ecs_add_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id) {
 	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
 	if (!storage) {
@@ -224,6 +776,27 @@ void* ecs_add_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t compon
 	return slot.data;
 }
 
+void* ecs_add_component_concurrent(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return NULL;
+	}
+	ecs_ss_slot_t slot;
+	int res = ecs_ss_emplace_concurrent(storage, entity_id, &slot);
+	if (ECS_OK != res) {
+		return NULL;
+	}
+	return slot.data;
+}
+
+bool ecs_reserve_component(ecs_registry_t* reg, ecs_id_t component_id, uint32_t entity_count, uint32_t count) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return false;
+	}
+	return ECS_OK == ecs_ss_reserve(storage, entity_count, count);
+}
+
 bool ecs_has_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t component_id) {
 	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
 	if (!storage) {
@@ -251,6 +824,69 @@ void ecs_remove_component(ecs_registry_t* reg, ecs_id_t entity_id, ecs_id_t comp
 	ecs_ss_erase(storage, entity_id);
 }
 
+int ecs_add_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id, const void* src, uint32_t src_stride) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return ECS_INVALID_ARG;
+	}
+	return ecs_ss_emplace_ex(storage, entity_ids, ECS_NULL_ID, count, src, ecs_component_bytes(storage), src_stride);
+}
+
+int ecs_add_component_range(ecs_registry_t* reg, ecs_id_t first, uint32_t count, ecs_id_t component_id, const void* src, uint32_t src_stride) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return ECS_INVALID_ARG;
+	}
+	return ecs_ss_emplace_ex(storage, NULL, first, count, src, ecs_component_bytes(storage), src_stride);
+}
+
+int ecs_remove_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return ECS_INVALID_ARG;
+	}
+	return ecs_ss_erase_ex(storage, entity_ids, ECS_NULL_ID, count);
+}
+
+int ecs_remove_component_range(ecs_registry_t* reg, ecs_id_t first, uint32_t count, ecs_id_t component_id) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return ECS_INVALID_ARG;
+	}
+	return ecs_ss_erase_ex(storage, NULL, first, count);
+}
+
+uint32_t ecs_get_component_n(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t component_id, void** out) {
+	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
+	if (!storage) {
+		return 0;
+	}
+	uint32_t found = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		out[i] = ecs_ss_get(storage, entity_ids[i]).data;
+		found += out[i] != NULL;
+	}
+	return found;
+}
+
+void ecs_clear_transient(ecs_registry_t* reg) {
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		if (ss->flags & ECS_SS_TRANSIENT) {
+			ecs_ss_clear(ss);
+		}
+	}
+}
+
+void ecs_compact(ecs_registry_t* reg) {
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		if ((ss->flags & ECS_SS_STABLE) && ss->hole_count > ss->max_holes) {
+			ecs_ss_compact(ss);
+		}
+	}
+}
+
 void ecs_iter_component(ecs_registry_t* reg, ecs_id_t component_id, pfn_ecs_iter_component_func callback) {
 	ecs_ss_t* storage = hashmap_find(reg->storage_map, &component_id);
 	if (!storage) {
@@ -258,6 +894,7 @@ void ecs_iter_component(ecs_registry_t* reg, ecs_id_t component_id, pfn_ecs_iter
 	}
 	for (uint32_t i = 0; i < storage->slot_count; i++) {
 		ecs_id_t id = ecs_ss_getid(storage, i);
+		if (ECS_NULL == id.id) continue;
 		ecs_ss_slot_t slot = ecs_ss_getslot(storage, i);
 		callback(reg, id, slot.data);
 	}
@@ -271,8 +908,12 @@ void ecs_system_v(ecs_registry_t* reg, pfn_ecs_iter_func func, uint32_t ncomps,
 	for (uint32_t i = 0; i < ncomps; i++) {
 		ecs_id_t comp = va_arg(vcomps, ecs_id_t);
 		ecs_ss_t* pool = hashmap_find(reg->storage_map, &comp);
-		assert(pool);
 		comps[i] = comp; pools[i] = pool;
+		if (!pool) {
+			// resources are declared alongside components but don't filter entities
+			assert(hashmap_find(reg->resource_map, &comp));
+			continue;
+		}
 		if (pool->slot_count < mincount) {
 			minidx = i; mincount = pool->slot_count;
 		}
@@ -280,11 +921,16 @@ void ecs_system_v(ecs_registry_t* reg, pfn_ecs_iter_func func, uint32_t ncomps,
 	if (mincount == 0) {
 		return;
 	}
+	if (mincount == UINT32_MAX) {
+		func(reg, ECS_NULL_ID, ncomps, comps); // resources only, run once
+		return;
+	}
 	for (uint32_t slot_idx = 0; slot_idx < pools[minidx]->slot_count; slot_idx++) {
 		ecs_id_t eid = pools[minidx]->dense_ids[slot_idx];
+		if (ECS_NULL == eid.id) continue;
 		bool has_all = true;
 		for (uint32_t comp_idx = 0; comp_idx < ncomps; comp_idx++) {
-			if (comp_idx == minidx) continue;
+			if (comp_idx == minidx || !pools[comp_idx]) continue;
 			ecs_ss_slot_t slot = ecs_ss_get(pools[comp_idx], eid);
 			if (!slot.data) {
 				has_all = false; break;
@@ -302,3 +948,1070 @@ void ecs_system(ecs_registry_t* reg, pfn_ecs_iter_func func, uint32_t ncomps, ..
 	ecs_system_v(reg, func, ncomps, vcomps);
 	va_end(vcomps);
 }
+
+
+/********************************************************************
+ * Prefab Implementation
+ *******************************************************************/
+typedef struct ecs_prefab_comp_t {
+	ecs_id_t 	component_id;
+	uint32_t 	offset;		// byte offset of the initial value in data
+	uint32_t 	size;		// byte size of the initial value
+} ecs_prefab_comp_t;
+
+struct ecs_prefab_t {
+	ecs_registry_t* 	reg;
+	uint32_t 			comp_count;
+	uint32_t 			data_size;
+	ecs_prefab_comp_t* 	comps;
+	uint8_t* 			data;	// initial values, packed back to back
+};
+
+ecs_prefab_t* ecs_prefab_create(ecs_registry_t* reg) {
+	ecs_prefab_t* prefab = malloc(sizeof(ecs_prefab_t));
+	prefab->reg = reg;
+	prefab->comp_count = 0;
+	prefab->data_size = 0;
+	prefab->comps = NULL;
+	prefab->data = NULL;
+	return prefab;
+}
+
+void ecs_prefab_destroy(ecs_prefab_t* prefab) {
+	free(prefab->comps);
+	free(prefab->data);
+	free(prefab);
+}
+
+int ecs_prefab_set_component(ecs_prefab_t* prefab, ecs_id_t component_id, const void* value) {
+	ecs_ss_t* storage = hashmap_find(prefab->reg->storage_map, &component_id);
+	if (!storage) {
+		return ECS_INVALID_ARG;
+	}
+	uint32_t size = ecs_component_bytes(storage);
+	for (uint32_t i = 0; i < prefab->comp_count; i++) {
+		ecs_prefab_comp_t* comp = &prefab->comps[i];
+		if (comp->component_id.id == component_id.id) {
+			if (value) memcpy(prefab->data + comp->offset, value, size);
+			else memzero(prefab->data + comp->offset, size);
+			return ECS_FOUND;
+		}
+	}
+	ecs_prefab_comp_t* comps = realloc(prefab->comps, sizeof(ecs_prefab_comp_t) * (prefab->comp_count + 1));
+	if (!comps) {
+		return ECS_OUT_OF_MEMORY;
+	}
+	prefab->comps = comps;
+	uint8_t* data = realloc(prefab->data, prefab->data_size + size);
+	if (!data && size) {
+		return ECS_OUT_OF_MEMORY;
+	}
+	prefab->data = data;
+	comps[prefab->comp_count++] = (ecs_prefab_comp_t) { component_id, prefab->data_size, size };
+	if (value) memcpy(prefab->data + prefab->data_size, value, size);
+	else memzero(prefab->data + prefab->data_size, size);
+	prefab->data_size += size;
+	return ECS_OK;
+}
+
+ecs_id_t ecs_prefab_instantiate(ecs_prefab_t* prefab, uint32_t count) {
+	ecs_id_t first = ecs_new_entity_range(prefab->reg, count);
+	if (ECS_NULL == first.id) {
+		return ECS_NULL_ID;
+	}
+	// fresh ids are never in a pool yet, so every component becomes one contiguous append
+	for (uint32_t i = 0; i < prefab->comp_count; i++) {
+		ecs_prefab_comp_t* comp = &prefab->comps[i];
+		ecs_ss_t* storage = hashmap_find(prefab->reg->storage_map, &comp->component_id);
+		int res = storage
+			? ecs_ss_emplace_ex(storage, NULL, first, count, prefab->data + comp->offset, comp->size, 0)
+			: ECS_INVALID_ARG;
+		if (ECS_OK != res) {
+			for (uint32_t j = 0; j < i; j++) {
+				ecs_remove_component_range(prefab->reg, first, count, prefab->comps[j].component_id);
+			}
+			return ECS_NULL_ID;
+		}
+	}
+	return first;
+}
+
+/********************************************************************
+ * Migration Implementation
+ *******************************************************************/
+
+/*
+ * Registries share no state, so shards can be ticked on their own threads.
+ * Migration touches both and must run while neither is being ticked.
+ * Entity i of the batch becomes first + i in dst; component data is copied
+ * as is, so ids stored inside components are not remapped.
+ */
+
+// pools created on the fly take the source pool's mode, so a transient or stable component stays one
+static void ecs_ss_copy_mode(ecs_ss_t* ss, const ecs_ss_t* from) {
+	if (from->flags & ECS_SS_STABLE) ecs_ss_set_stable(ss, true, from->max_holes);
+	ecs_ss_set_transient(ss, from->flags & ECS_SS_TRANSIENT);
+	if (from->flags & ECS_SS_CONCURRENT) ecs_ss_set_concurrent(ss, true);
+}
+
+static int ecs_migrate_pool(ecs_registry_t* dst, ecs_id_t component_id, ecs_ss_t* ss, const ecs_id_t* entity_ids, uint32_t count, ecs_id_t first, bool* created) {
+	*created = false;
+	ecs_id_t* new_ids = malloc(sizeof(ecs_id_t) * count);
+	uint8_t* slots = malloc((size_t)ss->slot_size * count);
+	if (!new_ids || !slots) {
+		free(new_ids); free(slots);
+		return ECS_OUT_OF_MEMORY;
+	}
+	// gather the batch's slots into one block so dst takes them as a single bulk append
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t index = entity_ids[i].id < ss->sparse_size ? ecs_ss_lookup(ss, entity_ids[i]) : ECS_NULL;
+		if (ECS_NULL == index) {
+			continue;
+		}
+		memcpy(slots + (size_t)ss->slot_size * n, ecs_ss_slotbyidx(ss, index), ss->slot_size);
+		new_ids[n++] = ecs_id(first.id + i);
+	}
+	int res = ECS_OK;
+	ecs_ss_t* storage = n ? hashmap_find(dst->storage_map, &component_id) : NULL;
+	if (n && !storage) {
+		if (ecs_register_component(dst, ecs_component_bytes(ss), component_id, first.id + count)) {
+			storage = hashmap_find(dst->storage_map, &component_id);
+			ecs_ss_copy_mode(storage, ss);
+			*created = true;
+		}
+		else {
+			res = ECS_OUT_OF_MEMORY;
+		}
+	}
+	if (storage && storage->slot_size != ss->slot_size) {
+		res = ECS_INVALID_ARG;
+	}
+	if (storage && ECS_OK == res) {
+		res = ecs_ss_emplace_ex(storage, new_ids, ECS_NULL_ID, n, slots, ss->slot_size, ss->slot_size);
+	}
+	free(new_ids);
+	free(slots);
+	return res;
+}
+
+// undoes a registration made by a failed migration
+static void ecs_migrate_drop_pool(ecs_registry_t* reg, ecs_id_t component_id) {
+	ecs_ss_t* ss = hashmap_find(reg->storage_map, &component_id);
+	if (!ss) {
+		return;
+	}
+	free(ss->sparse);
+	free(ss->dense_ids);
+	free(ss->dense_slots);
+	free(ss->holes);
+	hashmap_erase(reg->storage_map, &component_id, NULL);
+}
+
+// false if an id repeats or was never handed out by reg, a repeated id would be cloned in dst
+static bool ecs_migrate_check_ids(ecs_registry_t* reg, const ecs_id_t* entity_ids, uint32_t count) {
+	uint32_t next_id = __atomic_load_n(&reg->next_id.id, __ATOMIC_RELAXED);
+	uint64_t* seen = calloc(next_id / 64 + 1, sizeof(uint64_t));
+	if (!seen) {
+		return false;
+	}
+	bool valid = true;
+	for (uint32_t i = 0; i < count && valid; i++) {
+		uint32_t id = entity_ids[i].id;
+		valid = id < next_id && !(seen[id / 64] & (1ull << (id % 64)));
+		if (valid) {
+			seen[id / 64] |= 1ull << (id % 64);
+		}
+	}
+	free(seen);
+	return valid;
+}
+
+ecs_id_t ecs_migrate_entities(ecs_registry_t* dst, ecs_registry_t* src, const ecs_id_t* entity_ids, uint32_t count) {
+	// an empty batch is rejected like an empty ecs_new_entity_range
+	if (dst == src || count == 0 || !ecs_migrate_check_ids(src, entity_ids, count)) {
+		return ECS_NULL_ID;
+	}
+	uint32_t pool_count = 0;
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(src, idx, pcompid, ss) {
+		pool_count++;
+	}
+	// component ids of the src pools copied so far, and whether dst had to create each pool
+	ecs_id_t* copied = malloc(sizeof(ecs_id_t) * (pool_count ? pool_count : 1));
+	bool* created = malloc(sizeof(bool) * (pool_count ? pool_count : 1));
+	ecs_id_t first = (copied && created) ? ecs_new_entity_range(dst, count) : ECS_NULL_ID;
+	if (ECS_NULL == first.id) {
+		free(copied); free(created);
+		return ECS_NULL_ID;
+	}
+	// copy every pool first, src is only touched once nothing can fail
+	uint32_t done = 0;
+	ecs_foreach_pool(src, idx, pcompid, ss) {
+		copied[done] = *pcompid;
+		int res = ecs_migrate_pool(dst, *pcompid, ss, entity_ids, count, first, &created[done]);
+		done++;
+		if (ECS_OK != res) {
+			for (uint32_t i = 0; i < done; i++) {
+				if (created[i]) {
+					ecs_migrate_drop_pool(dst, copied[i]);
+				}
+				else {
+					ecs_remove_component_range(dst, first, count, copied[i]);
+				}
+			}
+			free(copied); free(created);
+			return ECS_NULL_ID;
+		}
+	}
+	ecs_foreach_pool(src, idx, pcompid, ss) {
+		ecs_ss_erase_ex(ss, entity_ids, ECS_NULL_ID, count);
+	}
+	free(copied); free(created);
+	ecs_debugf("Migrated %u entities to %u..%u", count, first.id, first.id + count - 1);
+	return first;
+}
+
+/********************************************************************
+ * Spatial Index Implementation
+ *******************************************************************/
+
+/*
+ * Hashed uniform grid over a float[3] position stored at `offset` in each
+ * slot of the bound pool. Every entity is linked into the bucket of its
+ * cell. Pool add/remove hooks queue entities as dirty, and so does
+ * ecs_spatial_touch after a move. ecs_spatial_update only relinks dirty
+ * entities whose cell actually changed.
+ */
+
+#define ECS_SPATIAL_BUCKETS 4096 // power of two
+#define ECS_SPATIAL_MAX_CELL 1073741824.0f // cell coordinates are clamped to +-2^30
+
+typedef struct ecs_spatial_node_t {
+	uint32_t 	next;		// next entity in bucket
+	uint32_t 	prev;		// previous entity in bucket
+	uint32_t 	bucket;		// ECS_NULL when not linked
+	int32_t 	cell[3];
+	bool 		dirty;
+} ecs_spatial_node_t;
+
+struct ecs_spatial_t {
+	ecs_registry_t* 		reg;
+	ecs_ss_t* 				pool;
+	uint32_t 				offset;			// byte offset of float[3] in slot
+	float 					cell_size;
+	float 					inv_cell_size;
+	uint32_t 				count;			// no. of linked entities
+	uint32_t* 				buckets;		// head entity per bucket
+	uint32_t 				node_count;		// reserved nodes, indexed by entity id
+	ecs_spatial_node_t* 	nodes;
+	uint32_t 				dirty_count;
+	uint32_t 				dirty_capacity;
+	ecs_id_t* 				dirty;
+};
+
+static uint32_t ecs_spatial_bucket(const int32_t cell[3]) {
+	uint32_t h = ((uint32_t)cell[0] * 73856093u) ^ ((uint32_t)cell[1] * 19349663u) ^ ((uint32_t)cell[2] * 83492791u);
+	return h & (ECS_SPATIAL_BUCKETS - 1);
+}
+
+static const float* ecs_spatial_pos(ecs_spatial_t* sp, ecs_id_t entity) {
+	ecs_ss_slot_t slot = ecs_ss_get(sp->pool, entity);
+	return slot.data ? (const float*)((uint8_t*)slot.data + sp->offset) : NULL;
+}
+
+static void ecs_spatial_cell(ecs_spatial_t* sp, const float pos[3], int32_t cell[3]) {
+	for (int i = 0; i < 3; i++) {
+		float c = floorf(pos[i] * sp->inv_cell_size);
+		c = c < -ECS_SPATIAL_MAX_CELL ? -ECS_SPATIAL_MAX_CELL : (c > ECS_SPATIAL_MAX_CELL ? ECS_SPATIAL_MAX_CELL : c);
+		cell[i] = (int32_t)c;
+	}
+}
+
+static bool ecs_spatial_reserve(ecs_spatial_t* sp, uint32_t entity) {
+	if (entity < sp->node_count) {
+		return true;
+	}
+	uint32_t node_count = (entity + 1 > 2 * sp->node_count) ? entity + 1 : 2 * sp->node_count;
+	ecs_spatial_node_t* nodes = realloc(sp->nodes, sizeof(ecs_spatial_node_t) * node_count);
+	if (!nodes) {
+		return false;
+	}
+	for (uint32_t i = sp->node_count; i < node_count; i++) {
+		nodes[i].bucket = ECS_NULL;
+		nodes[i].dirty = false;
+	}
+	sp->nodes = nodes;
+	sp->node_count = node_count;
+	return true;
+}
+
+static void ecs_spatial_unlink(ecs_spatial_t* sp, uint32_t entity) {
+	ecs_spatial_node_t* node = &sp->nodes[entity];
+	if (ECS_NULL == node->bucket) {
+		return;
+	}
+	if (ECS_NULL != node->prev) sp->nodes[node->prev].next = node->next;
+	else sp->buckets[node->bucket] = node->next;
+	if (ECS_NULL != node->next) sp->nodes[node->next].prev = node->prev;
+	node->bucket = ECS_NULL;
+	sp->count--;
+}
+
+static void ecs_spatial_link(ecs_spatial_t* sp, uint32_t entity, const int32_t cell[3]) {
+	ecs_spatial_node_t* node = &sp->nodes[entity];
+	node->bucket = ecs_spatial_bucket(cell);
+	memcpy(node->cell, cell, sizeof(node->cell));
+	node->prev = ECS_NULL;
+	node->next = sp->buckets[node->bucket];
+	if (ECS_NULL != node->next) sp->nodes[node->next].prev = entity;
+	sp->buckets[node->bucket] = entity;
+	sp->count++;
+}
+
+void ecs_spatial_touch(ecs_spatial_t* sp, ecs_id_t entity) {
+	if (!ecs_spatial_reserve(sp, entity.id) || sp->nodes[entity.id].dirty) {
+		return;
+	}
+	if (sp->dirty_count == sp->dirty_capacity) {
+		uint32_t capacity = sp->dirty_capacity ? 2 * sp->dirty_capacity : 256;
+		ecs_id_t* dirty = realloc(sp->dirty, sizeof(ecs_id_t) * capacity);
+		if (!dirty) {
+			return;
+		}
+		sp->dirty = dirty;
+		sp->dirty_capacity = capacity;
+	}
+	sp->nodes[entity.id].dirty = true;
+	sp->dirty[sp->dirty_count++] = entity;
+}
+
+static void ecs_spatial_on_emplace(void* data, ecs_id_t entity) {
+	ecs_spatial_touch(data, entity);
+}
+
+static void ecs_spatial_on_erase(void* data, ecs_id_t entity) {
+	ecs_spatial_t* sp = data;
+	if (entity.id < sp->node_count) {
+		ecs_spatial_unlink(sp, entity.id);
+	}
+}
+
+static void ecs_spatial_on_reset(void* data) {
+	ecs_spatial_rebuild(data);
+}
+
+void ecs_spatial_update(ecs_spatial_t* sp) {
+	for (uint32_t i = 0; i < sp->dirty_count; i++) {
+		uint32_t entity = sp->dirty[i].id;
+		ecs_spatial_node_t* node = &sp->nodes[entity];
+		node->dirty = false;
+		const float* pos = ecs_spatial_pos(sp, sp->dirty[i]);
+		if (!pos) {
+			ecs_spatial_unlink(sp, entity);
+			continue;
+		}
+		int32_t cell[3];
+		ecs_spatial_cell(sp, pos, cell);
+		if (ECS_NULL != node->bucket && 0 == memcmp(cell, node->cell, sizeof(cell))) {
+			continue;
+		}
+		ecs_spatial_unlink(sp, entity);
+		ecs_spatial_link(sp, entity, cell);
+	}
+	sp->dirty_count = 0;
+}
+
+void ecs_spatial_rebuild(ecs_spatial_t* sp) {
+	memset(sp->buckets, -1, sizeof(uint32_t) * ECS_SPATIAL_BUCKETS);
+	for (uint32_t i = 0; i < sp->node_count; i++) {
+		sp->nodes[i].bucket = ECS_NULL;
+		sp->nodes[i].dirty = false;
+	}
+	sp->count = 0;
+	sp->dirty_count = 0;
+	for (uint32_t i = 0; i < sp->pool->slot_count; i++) {
+		ecs_id_t id = sp->pool->dense_ids[i];
+		if (ECS_NULL != id.id) {
+			ecs_spatial_touch(sp, id);
+		}
+	}
+	ecs_spatial_update(sp);
+}
+
+ecs_spatial_t* ecs_spatial_create(ecs_registry_t* reg, ecs_id_t component_id, uint32_t offset, float cell_size) {
+	ecs_ss_t* pool = hashmap_find(reg->storage_map, &component_id);
+	if (!pool || cell_size <= 0.0f || offset + 3 * sizeof(float) > pool->slot_size) {
+		return NULL;
+	}
+	ecs_spatial_t* sp = malloc(sizeof(ecs_spatial_t));
+	sp->reg = reg;
+	sp->pool = pool;
+	sp->offset = offset;
+	sp->cell_size = cell_size;
+	sp->inv_cell_size = 1.0f / cell_size;
+	sp->count = 0;
+	sp->buckets = malloc(sizeof(uint32_t) * ECS_SPATIAL_BUCKETS);
+	sp->node_count = 0;
+	sp->nodes = NULL;
+	sp->dirty_count = 0;
+	sp->dirty_capacity = 0;
+	sp->dirty = NULL;
+	if (ECS_OK != ecs_ss_set_hooks(pool, ecs_spatial_on_emplace, ecs_spatial_on_erase, ecs_spatial_on_reset, sp)) {
+		free(sp->buckets);
+		free(sp);
+		return NULL;
+	}
+	ecs_spatial_rebuild(sp);
+	return sp;
+}
+
+void ecs_spatial_destroy(ecs_spatial_t* sp) {
+	ecs_ss_set_hooks(sp->pool, NULL, NULL, NULL, NULL);
+	free(sp->buckets);
+	free(sp->nodes);
+	free(sp->dirty);
+	free(sp);
+}
+
+typedef bool (*pfn_ecs_spatial_filter_func)(const float pos[3], const float* args);
+
+static bool ecs_spatial_in_box(const float pos[3], const float* box) {
+	for (int i = 0; i < 3; i++) {
+		if (pos[i] < box[i] || pos[i] > box[3 + i]) return false;
+	}
+	return true;
+}
+
+static float ecs_spatial_dist2(const float a[3], const float b[3]) {
+	float dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+	return dx * dx + dy * dy + dz * dz;
+}
+
+static bool ecs_spatial_in_sphere(const float pos[3], const float* sphere) {
+	return ecs_spatial_dist2(pos, sphere) <= sphere[3] * sphere[3];
+}
+
+/* visits every linked entity in the cells overlapping [min, max] that passes filter */
+static uint32_t ecs_spatial_collect(ecs_spatial_t* sp, const float min[3], const float max[3], pfn_ecs_spatial_filter_func filter, const float* args, ecs_id_t* out, uint32_t max_out) {
+	int32_t lo[3], hi[3];
+	ecs_spatial_cell(sp, min, lo);
+	ecs_spatial_cell(sp, max, hi);
+	uint64_t cells = 1;
+	for (int i = 0; i < 3 && cells <= ECS_SPATIAL_BUCKETS; i++) {
+		cells *= (uint64_t)((int64_t)hi[i] - lo[i] + 1);
+	}
+	uint32_t found = 0;
+	if (cells > ECS_SPATIAL_BUCKETS) {
+		// query spans more cells than there are buckets, walk the pool instead
+		for (uint32_t i = 0; i < sp->pool->slot_count && found < max_out; i++) {
+			ecs_id_t id = sp->pool->dense_ids[i];
+			if (ECS_NULL == id.id || id.id >= sp->node_count || ECS_NULL == sp->nodes[id.id].bucket) continue;
+			if (filter(ecs_spatial_pos(sp, id), args)) out[found++] = id;
+		}
+		return found;
+	}
+	int32_t cell[3];
+	for (cell[2] = lo[2]; cell[2] <= hi[2]; cell[2]++)
+	for (cell[1] = lo[1]; cell[1] <= hi[1]; cell[1]++)
+	for (cell[0] = lo[0]; cell[0] <= hi[0]; cell[0]++) {
+		for (uint32_t e = sp->buckets[ecs_spatial_bucket(cell)]; ECS_NULL != e; e = sp->nodes[e].next) {
+			if (0 != memcmp(sp->nodes[e].cell, cell, sizeof(cell))) continue; // other cell in the same bucket
+			if (!filter(ecs_spatial_pos(sp, ecs_id(e)), args)) continue;
+			if (found == max_out) return found;
+			out[found++] = ecs_id(e);
+		}
+	}
+	return found;
+}
+
+uint32_t ecs_spatial_query_box(ecs_spatial_t* sp, const float min[3], const float max[3], ecs_id_t* out, uint32_t max_out) {
+	float box[6] = { min[0], min[1], min[2], max[0], max[1], max[2] };
+	return ecs_spatial_collect(sp, min, max, ecs_spatial_in_box, box, out, max_out);
+}
+
+uint32_t ecs_spatial_query_radius(ecs_spatial_t* sp, const float center[3], float radius, ecs_id_t* out, uint32_t max_out) {
+	float sphere[4] = { center[0], center[1], center[2], radius };
+	float min[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+	float max[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+	return ecs_spatial_collect(sp, min, max, ecs_spatial_in_sphere, sphere, out, max_out);
+}
+
+uint32_t ecs_spatial_query_nearest(ecs_spatial_t* sp, const float center[3], uint32_t k, ecs_id_t* out) {
+	if (k == 0 || sp->count == 0) {
+		return 0;
+	}
+	ecs_id_t* candidates = malloc(sizeof(ecs_id_t) * sp->count);
+	float* dist = malloc(sizeof(float) * sp->count);
+	if (!candidates || !dist) {
+		free(candidates); free(dist);
+		return 0;
+	}
+	// grow the search sphere until it holds k entities, the k closest inside it are then exact
+	uint32_t found = 0;
+	for (float radius = sp->cell_size; ; radius *= 2.0f) {
+		found = ecs_spatial_query_radius(sp, center, radius, candidates, sp->count);
+		if (found >= k || found == sp->count) break;
+		if (radius > sp->cell_size * ECS_SPATIAL_BUCKETS) {
+			// sparse outliers, just rank every linked entity
+			float everywhere[6] = { -INFINITY, -INFINITY, -INFINITY, INFINITY, INFINITY, INFINITY };
+			found = ecs_spatial_collect(sp, everywhere, everywhere + 3, ecs_spatial_in_box, everywhere, candidates, sp->count);
+			break;
+		}
+	}
+	for (uint32_t i = 0; i < found; i++) {
+		dist[i] = ecs_spatial_dist2(ecs_spatial_pos(sp, candidates[i]), center);
+	}
+	uint32_t n = found < k ? found : k;
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t best = i;
+		for (uint32_t j = i + 1; j < found; j++) {
+			if (dist[j] < dist[best]) best = j;
+		}
+		out[i] = candidates[best];
+		candidates[best] = candidates[i]; dist[best] = dist[i];
+	}
+	free(candidates);
+	free(dist);
+	return n;
+}
+
+/********************************************************************
+ * Event Implementation
+ *******************************************************************/
+
+/*
+ * Each channel has two fixed-capacity buffers. Producers reserve a
+ * contiguous run in the write buffer with a CAS on write_count, so
+ * emitting is lock-free and safe from any thread. ecs_swap_events runs at
+ * the frame boundary, once producers are done: the write buffer becomes
+ * the read buffer, and consumers see last frame's events as one array.
+ */
+
+struct ecs_events_t {
+	uint32_t 	event_size;
+	uint32_t 	capacity;		// max events per frame
+	uint32_t 	write_count;	// reserved events in the write buffer, updated atomically
+	uint32_t 	read_count;		// events in the read buffer
+	uint32_t 	write_index;	// which buffer is being written
+	uint8_t* 	buffers[2];
+};
+
+static void ecs_events_destroy(ecs_events_t* ch) {
+	free(ch->buffers[0]);
+	free(ch->buffers[1]);
+	free(ch);
+}
+
+bool ecs_register_event(ecs_registry_t* reg, uint32_t event_size, ecs_id_t event_id, uint32_t capacity) {
+	ecs_events_t* ch = malloc(sizeof(ecs_events_t));
+	if (!ch) {
+		return false;
+	}
+	ch->event_size = event_size;
+	ch->capacity = capacity;
+	ch->write_count = 0;
+	ch->read_count = 0;
+	ch->write_index = 0;
+	ch->buffers[0] = malloc((size_t)event_size * capacity);
+	ch->buffers[1] = malloc((size_t)event_size * capacity);
+	ecs_events_t** slot = (ch->buffers[0] && ch->buffers[1]) ? hashmap_emplace(reg->event_map, &event_id) : NULL;
+	if (!slot) {
+		ecs_events_destroy(ch);
+		return false;
+	}
+	*slot = ch;
+	return true;
+}
+
+ecs_events_t* ecs_event_channel(ecs_registry_t* reg, ecs_id_t event_id) {
+	ecs_events_t** slot = hashmap_find(reg->event_map, &event_id);
+	return slot ? *slot : NULL;
+}
+
+void* ecs_events_emit(ecs_events_t* ch, uint32_t count) {
+	uint32_t start = __atomic_load_n(&ch->write_count, __ATOMIC_RELAXED);
+	do {
+		if (count > ch->capacity - start) {
+			ecs_debugf("event channel full (%u)", ch->capacity);
+			return NULL;
+		}
+	} while (!__atomic_compare_exchange_n(&ch->write_count, &start, start + count, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return ch->buffers[ch->write_index] + (size_t)ch->event_size * start;
+}
+
+bool ecs_events_send(ecs_events_t* ch, const void* event) {
+	void* dst = ecs_events_emit(ch, 1);
+	if (!dst) {
+		return false;
+	}
+	memcpy(dst, event, ch->event_size);
+	return true;
+}
+
+const void* ecs_events_read(ecs_events_t* ch, uint32_t* count) {
+	*count = ch->read_count;
+	return ch->buffers[ch->write_index ^ 1];
+}
+
+void ecs_swap_events(ecs_registry_t* reg) {
+	ecs_id_t* pid; ecs_events_t** pch;
+	for (uint32_t idx = hashmap_iternext(reg->event_map, 0, (void**)&pid, (void**)&pch); idx != ECS_NULL; idx = hashmap_iternext(reg->event_map, idx, (void**)&pid, (void**)&pch)) {
+		ecs_events_t* ch = *pch;
+		ch->read_count = __atomic_exchange_n(&ch->write_count, 0, __ATOMIC_ACQ_REL);
+		ch->write_index ^= 1;
+	}
+}
+
+/********************************************************************
+ * Snapshot Implementation
+ *******************************************************************/
+
+/*
+ * Each saved frame is the registry flattened into a fixed layout:
+ *   next_id | resources | per pool: slot_count, hole_count, dense_ids[dense_size], dense_slots[dense_size]
+ *   and, for pools with a free list, holes[dense_size]
+ * Sparse arrays aren't saved, restore rebuilds them from dense_ids. Every
+ * byte past a pool's slot_count / hole_count is kept zero, so saving, diffing
+ * and restoring only walk the used prefix of each pool, never its reserved
+ * capacity. Only the newest frame is kept in full (base). Older frames are
+ * kept as xor deltas against their successor, stored as runs of
+ *   u32 skip | u32 len | len bytes of xor
+ * so unchanged ranges cost nothing. Restoring n frames back xors the n
+ * newest deltas into a copy of base and copies the result into the pools.
+ * When pools grow or are registered, the saved frames are re-laid out to the
+ * new sizes (a missing pool reads as empty), so wave spawns through the bulk
+ * paths keep the history. Registering a resource still starts it over.
+ */
+
+#define ECS_SNAPSHOT_MIN_RUN 16 // equal bytes needed to end a literal run
+#define ECS_SNAPSHOT_BLOCK 64 	// unchanged ranges are skipped this many bytes at a time
+
+typedef struct ecs_snapshot_pool_t {
+	ecs_id_t 	component_id;
+	uint32_t 	slot_size;
+	uint32_t 	dense_size;
+	bool 		has_holes;
+	size_t 		offset;			// of the pool's section in a frame
+} ecs_snapshot_pool_t;
+
+typedef struct ecs_snapshot_delta_t {
+	uint8_t* 	data;
+	size_t 		size;
+	size_t 		capacity;
+} ecs_snapshot_delta_t;
+
+struct ecs_snapshot_t {
+	ecs_registry_t* 		reg;
+	uint32_t 				frame_capacity;	// max no. of frames kept
+	uint32_t 				frame_count;	// no. of frames saved
+	uint32_t 				head;			// ring index of the next delta
+	size_t 					state_size;		// byte size of a flattened frame
+	uint32_t 				resource_size;	// layout the saved frames are in
+	uint32_t 				pool_count;
+	ecs_snapshot_pool_t* 	pools;
+	uint8_t* 				base;			// newest frame
+	uint8_t* 				scratch;		// working frame
+	ecs_snapshot_delta_t* 	deltas;			// ring of xor deltas, each takes a frame to its predecessor
+};
+
+#define ecs_snapshot_header_size(resource_size) (sizeof(ecs_id_t) + (resource_size))
+#define ecs_snapshot_ids_at(pool) ((pool)->offset + 2 * sizeof(uint32_t))
+#define ecs_snapshot_slots_at(pool) (ecs_snapshot_ids_at(pool) + sizeof(ecs_id_t) * (size_t)(pool)->dense_size)
+#define ecs_snapshot_holes_at(pool) (ecs_snapshot_slots_at(pool) + (size_t)(pool)->slot_size * (pool)->dense_size)
+
+static size_t ecs_snapshot_pool_size(const ecs_snapshot_pool_t* pool) {
+	size_t size = 2 * sizeof(uint32_t);
+	size += (sizeof(ecs_id_t) + pool->slot_size) * (size_t)pool->dense_size;
+	if (pool->has_holes) {
+		size += sizeof(uint32_t) * pool->dense_size;
+	}
+	return size;
+}
+
+// slot_count and hole_count of a pool in a frame
+static void ecs_snapshot_counts(const ecs_snapshot_pool_t* pool, const uint8_t* state, uint32_t counts[2]) {
+	memcpy(counts, state + pool->offset, 2 * sizeof(uint32_t));
+}
+
+// describes the registry's pools in the order gather and scatter walk them
+static ecs_snapshot_pool_t* ecs_snapshot_layout(ecs_registry_t* reg, uint32_t* pool_count, size_t* state_size) {
+	uint32_t count = 0;
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		count++;
+	}
+	ecs_snapshot_pool_t* pools = malloc(sizeof(ecs_snapshot_pool_t) * (count ? count : 1));
+	if (!pools) {
+		return NULL;
+	}
+	size_t size = ecs_snapshot_header_size(reg->resource_size);
+	count = 0;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		ecs_snapshot_pool_t* pool = &pools[count++];
+		*pool = (ecs_snapshot_pool_t) { *pcompid, ss->slot_size, ss->dense_size, ss->holes != NULL, size };
+		size += ecs_snapshot_pool_size(pool);
+	}
+	*pool_count = count;
+	*state_size = size;
+	return pools;
+}
+
+static void ecs_snapshot_write_range(uint8_t* dst, const void* src, size_t used, size_t old_used) {
+	if (used) memcpy(dst, src, used);
+	if (old_used > used) memzero(dst + used, old_used - used);
+}
+
+// writes a pool's counts and used prefix, zeroing what the frame held past it before
+static void ecs_snapshot_write_pool(const ecs_snapshot_pool_t* pool, uint8_t* state, const uint32_t counts[2], const void* ids, const void* slots, const void* holes) {
+	uint32_t old[2];
+	ecs_snapshot_counts(pool, state, old);
+	memcpy(state + pool->offset, counts, 2 * sizeof(uint32_t));
+	ecs_snapshot_write_range(state + ecs_snapshot_ids_at(pool), ids, sizeof(ecs_id_t) * counts[0], sizeof(ecs_id_t) * old[0]);
+	ecs_snapshot_write_range(state + ecs_snapshot_slots_at(pool), slots, (size_t)pool->slot_size * counts[0], (size_t)pool->slot_size * old[0]);
+	if (pool->has_holes) {
+		ecs_snapshot_write_range(state + ecs_snapshot_holes_at(pool), holes, sizeof(uint32_t) * counts[1], sizeof(uint32_t) * old[1]);
+	}
+}
+
+static void ecs_snapshot_gather(ecs_snapshot_t* snap, uint8_t* state) {
+	ecs_registry_t* reg = snap->reg;
+	memcpy(state, &reg->next_id, sizeof(ecs_id_t));
+	if (reg->resource_size) {
+		memcpy(state + sizeof(ecs_id_t), reg->resources, reg->resource_size);
+	}
+	uint32_t i = 0;
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		uint32_t counts[2] = { ss->slot_count, ss->holes ? ss->hole_count : 0 };
+		ecs_snapshot_write_pool(&snap->pools[i++], state, counts, ss->dense_ids, ss->dense_slots, ss->holes);
+	}
+}
+
+static void ecs_snapshot_copy(const ecs_snapshot_t* snap, uint8_t* dst, const uint8_t* src) {
+	memcpy(dst, src, ecs_snapshot_header_size(snap->resource_size));
+	for (uint32_t i = 0; i < snap->pool_count; i++) {
+		const ecs_snapshot_pool_t* pool = &snap->pools[i];
+		uint32_t counts[2];
+		ecs_snapshot_counts(pool, src, counts);
+		ecs_snapshot_write_pool(pool, dst, counts, src + ecs_snapshot_ids_at(pool), src + ecs_snapshot_slots_at(pool), src + ecs_snapshot_holes_at(pool));
+	}
+}
+
+static void ecs_snapshot_scatter(ecs_snapshot_t* snap, const uint8_t* state) {
+	ecs_registry_t* reg = snap->reg;
+	memcpy(&reg->next_id, state, sizeof(ecs_id_t));
+	if (reg->resource_size) {
+		memcpy(reg->resources, state + sizeof(ecs_id_t), reg->resource_size);
+	}
+	uint32_t i = 0;
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(reg, idx, pcompid, ss) {
+		const ecs_snapshot_pool_t* pool = &snap->pools[i++];
+		uint32_t counts[2];
+		ecs_snapshot_counts(pool, state, counts);
+		ss->slot_count = counts[0];
+		memcpy(ss->dense_ids, state + ecs_snapshot_ids_at(pool), sizeof(ecs_id_t) * ss->slot_count);
+		memcpy(ss->dense_slots, state + ecs_snapshot_slots_at(pool), (size_t)ss->slot_size * ss->slot_count);
+		if (ss->holes) {
+			ss->hole_count = counts[1];
+			memcpy(ss->holes, state + ecs_snapshot_holes_at(pool), sizeof(uint32_t) * ss->hole_count);
+		}
+		// stale sparse entries elsewhere are rejected by ecs_ss_lookup
+		for (uint32_t k = 0; k < ss->slot_count; k++) {
+			uint32_t id = ss->dense_ids[k].id;
+			if (ECS_NULL != id && id < ss->sparse_size) {
+				ss->sparse[id] = k;
+			}
+		}
+		if (ss->flags & ECS_SS_CONCURRENT) {
+			memset(ss->dense_ids + ss->slot_count, -1, sizeof(ecs_id_t) * (ss->dense_size - ss->slot_count));
+		}
+		if (ss->on_reset) {
+			ss->on_reset(ss->hook_data);
+		}
+	}
+}
+
+static bool ecs_snapshot_delta_reserve(ecs_snapshot_delta_t* delta, size_t extra) {
+	if (delta->size + extra <= delta->capacity) {
+		return true;
+	}
+	size_t capacity = delta->capacity ? delta->capacity : 256;
+	while (capacity < delta->size + extra) {
+		capacity *= 2;
+	}
+	uint8_t* data = realloc(delta->data, capacity);
+	if (!data) {
+		return false;
+	}
+	delta->data = data;
+	delta->capacity = capacity;
+	return true;
+}
+
+// appends the runs for [begin, end), pos is where the previous run ended
+static int ecs_snapshot_encode_range(ecs_snapshot_delta_t* delta, const uint8_t* cur, const uint8_t* prev, size_t begin, size_t end, size_t* pos) {
+	size_t i = begin;
+	while (i < end) {
+		while (i + ECS_SNAPSHOT_BLOCK <= end && 0 == memcmp(cur + i, prev + i, ECS_SNAPSHOT_BLOCK)) i += ECS_SNAPSHOT_BLOCK;
+		while (i < end && cur[i] == prev[i]) i++;
+		if (i == end) {
+			break;
+		}
+		size_t lit_start = i;
+		uint32_t equal = 0;
+		while (i < end && equal < ECS_SNAPSHOT_MIN_RUN) {
+			equal = (cur[i] == prev[i]) ? equal + 1 : 0;
+			i++;
+		}
+		i -= equal; // trailing equal bytes are left to the next skip
+		uint32_t skip = (uint32_t)(lit_start - *pos);
+		uint32_t len = (uint32_t)(i - lit_start);
+		if (!ecs_snapshot_delta_reserve(delta, 2 * sizeof(uint32_t) + len)) {
+			return ECS_OUT_OF_MEMORY;
+		}
+		uint8_t* out = delta->data + delta->size;
+		memcpy(out, &skip, sizeof(uint32_t));
+		memcpy(out + sizeof(uint32_t), &len, sizeof(uint32_t));
+		out += 2 * sizeof(uint32_t);
+		for (uint32_t k = 0; k < len; k++) {
+			out[k] = cur[lit_start + k] ^ prev[lit_start + k];
+		}
+		delta->size += 2 * sizeof(uint32_t) + len;
+		*pos = i;
+	}
+	return ECS_OK;
+}
+
+// only the used prefix of each pool can differ, past it both frames are zero
+static int ecs_snapshot_encode(ecs_snapshot_delta_t* delta, const uint8_t* cur, const uint8_t* prev, uint32_t resource_size, const ecs_snapshot_pool_t* pools, uint32_t pool_count) {
+	delta->size = 0;
+	size_t pos = 0;
+	int res = ecs_snapshot_encode_range(delta, cur, prev, 0, ecs_snapshot_header_size(resource_size), &pos);
+	for (uint32_t i = 0; i < pool_count && ECS_OK == res; i++) {
+		const ecs_snapshot_pool_t* pool = &pools[i];
+		uint32_t a[2], b[2];
+		ecs_snapshot_counts(pool, cur, a);
+		ecs_snapshot_counts(pool, prev, b);
+		size_t slots = a[0] > b[0] ? a[0] : b[0];
+		size_t holes = a[1] > b[1] ? a[1] : b[1];
+		size_t at = ecs_snapshot_ids_at(pool);
+		res = ecs_snapshot_encode_range(delta, cur, prev, pool->offset, at + sizeof(ecs_id_t) * slots, &pos);
+		at = ecs_snapshot_slots_at(pool);
+		if (ECS_OK == res) res = ecs_snapshot_encode_range(delta, cur, prev, at, at + (size_t)pool->slot_size * slots, &pos);
+		at = ecs_snapshot_holes_at(pool);
+		if (ECS_OK == res && pool->has_holes) res = ecs_snapshot_encode_range(delta, cur, prev, at, at + sizeof(uint32_t) * holes, &pos);
+	}
+	return res;
+}
+
+static void ecs_snapshot_apply(const ecs_snapshot_delta_t* delta, uint8_t* state) {
+	const uint8_t* in = delta->data;
+	const uint8_t* end = delta->data + delta->size;
+	size_t offset = 0;
+	while (in < end) {
+		uint32_t skip, len;
+		memcpy(&skip, in, sizeof(uint32_t));
+		memcpy(&len, in + sizeof(uint32_t), sizeof(uint32_t));
+		in += 2 * sizeof(uint32_t);
+		offset += skip;
+		for (uint32_t k = 0; k < len; k++) {
+			state[offset + k] ^= in[k];
+		}
+		in += len;
+		offset += len;
+	}
+}
+
+// rewrites a frame from the old layout into the new one, out must be zeroed
+static void ecs_snapshot_convert(const ecs_snapshot_t* snap, const uint8_t* state, const ecs_snapshot_pool_t* pools, uint32_t pool_count, uint8_t* out) {
+	memcpy(out, state, ecs_snapshot_header_size(snap->resource_size));
+	for (uint32_t i = 0; i < pool_count; i++) {
+		const ecs_snapshot_pool_t* to = &pools[i];
+		for (uint32_t j = 0; j < snap->pool_count; j++) {
+			const ecs_snapshot_pool_t* from = &snap->pools[j];
+			if (from->component_id.id != to->component_id.id) {
+				continue;
+			}
+			uint32_t counts[2];
+			ecs_snapshot_counts(from, state, counts);
+			if (!from->has_holes) counts[1] = 0;
+			ecs_snapshot_write_pool(to, out, counts, state + ecs_snapshot_ids_at(from), state + ecs_snapshot_slots_at(from), state + ecs_snapshot_holes_at(from));
+			break;
+		}
+		// a pool registered since stays zeroed, it was empty back then
+	}
+}
+
+static bool ecs_snapshot_same_layout(const ecs_snapshot_t* snap) {
+	if (!snap->state_size || snap->resource_size != snap->reg->resource_size) {
+		return false;
+	}
+	uint32_t i = 0;
+	ecs_id_t* pcompid; ecs_ss_t* ss;
+	ecs_foreach_pool(snap->reg, idx, pcompid, ss) {
+		if (i >= snap->pool_count) {
+			return false;
+		}
+		const ecs_snapshot_pool_t* pool = &snap->pools[i++];
+		if (pool->component_id.id != pcompid->id || pool->slot_size != ss->slot_size
+			|| pool->dense_size != ss->dense_size || pool->has_holes != (ss->holes != NULL)) {
+			return false;
+		}
+	}
+	return i == snap->pool_count;
+}
+
+// false if the saved frames can't be carried over to the registry's layout
+static bool ecs_snapshot_can_convert(const ecs_snapshot_t* snap, const ecs_snapshot_pool_t* pools, uint32_t pool_count) {
+	if (snap->resource_size != snap->reg->resource_size) {
+		return false;
+	}
+	for (uint32_t j = 0; j < snap->pool_count; j++) {
+		const ecs_snapshot_pool_t* from = &snap->pools[j];
+		bool kept = false;
+		for (uint32_t i = 0; i < pool_count && !kept; i++) {
+			const ecs_snapshot_pool_t* to = &pools[i];
+			kept = to->component_id.id == from->component_id.id && to->slot_size == from->slot_size
+				&& to->dense_size >= from->dense_size && (to->has_holes || !from->has_holes);
+		}
+		if (!kept) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// brings base and every delta to the registry's current layout, a no-op unless pools changed
+static int ecs_snapshot_relayout(ecs_snapshot_t* snap) {
+	if (ecs_snapshot_same_layout(snap)) {
+		return ECS_OK;
+	}
+	uint32_t pool_count;
+	size_t state_size;
+	ecs_snapshot_pool_t* pools = ecs_snapshot_layout(snap->reg, &pool_count, &state_size);
+	if (!pools) {
+		return ECS_OUT_OF_MEMORY;
+	}
+	uint8_t* base = calloc(1, state_size);
+	uint8_t* next[2] = { calloc(1, state_size), calloc(1, state_size) };
+	if (!base || !next[0] || !next[1]) {
+		free(pools); free(base); free(next[0]); free(next[1]);
+		return ECS_OUT_OF_MEMORY;
+	}
+	if (snap->frame_count > 0 && ecs_snapshot_can_convert(snap, pools, pool_count)) {
+		// walk the frames newest to oldest in the old layout, re-encoding each delta in the new one
+		uint8_t* frame = snap->scratch;
+		memcpy(frame, snap->base, snap->state_size);
+		ecs_snapshot_convert(snap, frame, pools, pool_count, base);
+		uint8_t* newer = base;
+		uint32_t pos = snap->head;
+		for (uint32_t j = 1; j < snap->frame_count; j++) {
+			pos = (pos + snap->frame_capacity - 1) % snap->frame_capacity;
+			ecs_snapshot_apply(&snap->deltas[pos], frame);
+			uint8_t* older = next[j & 1];
+			memzero(older, state_size);
+			ecs_snapshot_convert(snap, frame, pools, pool_count, older);
+			if (ECS_OK != ecs_snapshot_encode(&snap->deltas[pos], newer, older, snap->reg->resource_size, pools, pool_count)) {
+				snap->frame_count = j; // older frames are lost, the ones before stay valid
+				break;
+			}
+			newer = older;
+		}
+	}
+	else {
+		snap->frame_count = 0;
+		snap->head = 0;
+	}
+	free(snap->base);
+	free(snap->scratch);
+	free(snap->pools);
+	// whichever spare holds the last converted frame is still a valid zero-padded frame
+	snap->base = base;
+	snap->scratch = next[0];
+	free(next[1]);
+	snap->state_size = state_size;
+	snap->resource_size = snap->reg->resource_size;
+	snap->pool_count = pool_count;
+	snap->pools = pools;
+	return ECS_OK;
+}
+
+ecs_snapshot_t* ecs_snapshot_create(ecs_registry_t* reg, uint32_t frame_count) {
+	if (frame_count == 0) {
+		return NULL;
+	}
+	ecs_snapshot_t* snap = malloc(sizeof(ecs_snapshot_t));
+	snap->reg = reg;
+	snap->frame_capacity = frame_count;
+	snap->frame_count = 0;
+	snap->head = 0;
+	snap->state_size = 0;
+	snap->resource_size = 0;
+	snap->pool_count = 0;
+	snap->pools = NULL;
+	snap->base = NULL;
+	snap->scratch = NULL;
+	snap->deltas = calloc(frame_count, sizeof(ecs_snapshot_delta_t));
+	return snap;
+}
+
+void ecs_snapshot_destroy(ecs_snapshot_t* snap) {
+	for (uint32_t i = 0; i < snap->frame_capacity; i++) {
+		free(snap->deltas[i].data);
+	}
+	free(snap->deltas);
+	free(snap->pools);
+	free(snap->base);
+	free(snap->scratch);
+	free(snap);
+}
+
+uint32_t ecs_snapshot_count(ecs_snapshot_t* snap) {
+	return snap->frame_count;
+}
+
+int ecs_snapshot_save(ecs_snapshot_t* snap) {
+	// carry saved frames over to pools grown or registered since the last save,
+	// only a newly registered resource starts the history over
+	int res = ecs_snapshot_relayout(snap);
+	if (ECS_OK != res) {
+		return res;
+	}
+	ecs_snapshot_gather(snap, snap->scratch);
+	if (snap->frame_count > 0) {
+		res = ecs_snapshot_encode(&snap->deltas[snap->head], snap->scratch, snap->base, snap->resource_size, snap->pools, snap->pool_count);
+		if (ECS_OK != res) {
+			return res;
+		}
+		snap->head = (snap->head + 1) % snap->frame_capacity;
+	}
+	uint8_t* tmp = snap->base;
+	snap->base = snap->scratch;
+	snap->scratch = tmp;
+	if (snap->frame_count < snap->frame_capacity) {
+		snap->frame_count++;
+	}
+	ecs_debugf("saved frame %u (%zu bytes)", snap->frame_count, snap->state_size);
+	return ECS_OK;
+}
+
+// pools are rewritten whole, their listeners get on_reset rather than per-entity hooks
+int ecs_snapshot_restore(ecs_snapshot_t* snap, uint32_t frames_back) {
+	if (ECS_OK != ecs_snapshot_relayout(snap) || frames_back >= snap->frame_count) {
+		return ECS_INVALID_ARG;
+	}
+	ecs_snapshot_copy(snap, snap->scratch, snap->base);
+	for (uint32_t i = 0; i < frames_back; i++) {
+		snap->head = (snap->head + snap->frame_capacity - 1) % snap->frame_capacity;
+		ecs_snapshot_apply(&snap->deltas[snap->head], snap->scratch);
+	}
+	ecs_snapshot_scatter(snap, snap->scratch);
+	// frames newer than the restored one are dropped, it becomes the base for the next save
+	uint8_t* tmp = snap->base;
+	snap->base = snap->scratch;
+	snap->scratch = tmp;
+	snap->frame_count -= frames_back;
+	return ECS_OK;
+}
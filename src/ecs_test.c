@@ -1,6 +1,7 @@
 #include "ecs.h"
 
 #include <stdio.h>
+#include <pthread.h>
 
 #define test_debugf(fmt, ...) DEBUG_CHANNEL(test, fmt, ##__VA_ARGS__)
 
@@ -32,6 +33,125 @@ int ecs_ss_test() {
 	ecs_ss_destroy(ss);
 	return 0;
 }
+static int meshrenderer_compare(const void* lhs, const void* rhs) {
+	const MeshRenderer* a = lhs;
+	const MeshRenderer* b = rhs;
+	if (a->materialId.id != b->materialId.id) return a->materialId.id < b->materialId.id ? -1 : 1;
+	if (a->meshId.id != b->meshId.id) return a->meshId.id < b->meshId.id ? -1 : 1;
+	return 0;
+}
+
+static uint32_t meshrenderer_material_key(const void* slot) {
+	return ((const MeshRenderer*)slot)->materialId.id;
+}
+
+static bool ecs_ss_check_sorted(ecs_ss_t* ss, uint32_t count) {
+	for (uint32_t i = 0; i < count; i++) {
+		ecs_id_t id = ecs_ss_getid(ss, i);
+		if (ecs_ss_get(ss, id).data != ecs_ss_getslot(ss, i).data) return false;
+		if (i > 0 && meshrenderer_compare(ecs_ss_getslot(ss, i - 1).data, ecs_ss_getslot(ss, i).data) > 0) return false;
+	}
+	return true;
+}
+
+int ecs_ss_sort_test() {
+	const uint32_t count = 32;
+	ecs_ss_t* ss = ecs_ss_create(sizeof(MeshRenderer), 100, count);
+	ecs_ss_t* ref = ecs_ss_create(sizeof(MeshRenderer), 100, count);
+	ecs_ss_slot_t slot;
+	for (uint32_t i = 0; i < count; i++) {
+		ecs_ss_emplace(ss, ecs_id(i * 3), &slot);
+		*(MeshRenderer*)slot.data = (MeshRenderer) { ecs_id(i), ecs_id((i * 7919) % 5), 0 };
+		ecs_ss_emplace(ref, ecs_id(99 - i * 3), &slot);
+	}
+
+	ecs_ss_sort(ss, meshrenderer_compare);
+	bool sorted = ecs_ss_check_sorted(ss, count);
+	test_debugf("ecs_ss_sort : %s", sorted ? "sorted" : "NOT sorted");
+
+	ecs_ss_sort_as(ss, ref);
+	bool aligned = true;
+	for (uint32_t i = 0, pos = 0; i < count; i++) {
+		ecs_id_t id = ecs_ss_getid(ref, i);
+		if (!ecs_ss_has(ss, id)) continue;
+		aligned = aligned && ecs_ss_getid(ss, pos++).id == id.id;
+	}
+	test_debugf("ecs_ss_sort_as : %s", aligned ? "aligned" : "NOT aligned");
+
+	ecs_ss_sort_radix(ss, meshrenderer_material_key);
+	bool keyed = true;
+	for (uint32_t i = 1; i < count; i++) {
+		keyed = keyed && meshrenderer_material_key(ecs_ss_getslot(ss, i - 1).data) <= meshrenderer_material_key(ecs_ss_getslot(ss, i).data);
+		keyed = keyed && ecs_ss_get(ss, ecs_ss_getid(ss, i)).data == ecs_ss_getslot(ss, i).data;
+	}
+	test_debugf("ecs_ss_sort_radix : %s", keyed ? "sorted" : "NOT sorted");
+
+	ecs_ss_destroy(ref);
+	ecs_ss_destroy(ss);
+	return (sorted && aligned && keyed) ? 0 : 1;
+}
+
+int ecs_ss_stable_test() {
+	ecs_ss_t* ss = ecs_ss_create(sizeof(MeshRenderer), 100, 32);
+	ecs_ss_set_stable(ss, true, 4);
+	ecs_ss_slot_t slot;
+	for (uint32_t i = 0; i < 8; i++) {
+		ecs_ss_emplace(ss, ecs_id(i), &slot);
+		*(MeshRenderer*)slot.data = (MeshRenderer) { ecs_id(i), ecs_id(0), 0 };
+	}
+	MeshRenderer* last = ecs_ss_get(ss, ecs_id(7)).data;
+	ecs_ss_erase(ss, ecs_id(2));
+	ecs_ss_erase(ss, ecs_id(5));
+	bool stable = ecs_ss_get(ss, ecs_id(7)).data == last && last->meshId.id == 7;
+	ecs_ss_emplace(ss, ecs_id(20), &slot);
+	bool reused = slot.data == ecs_ss_getslot(ss, 5).data;
+	ecs_ss_compact(ss);
+	bool compacted = true;
+	for (uint32_t i = 0, prev = 0; i < 7; i++) {
+		ecs_id_t id = ecs_ss_getid(ss, i);
+		compacted = compacted && ECS_NULL != id.id && ecs_ss_get(ss, id).data == ecs_ss_getslot(ss, i).data;
+		if (id.id != 20) { compacted = compacted && (i == 0 || id.id > prev); prev = id.id; }
+	}
+	ecs_ss_destroy(ss);
+
+	// a bulk add that fits in the holes of a full pool must not reallocate it
+	ss = ecs_ss_create(sizeof(MeshRenderer), 100, 32);
+	ecs_ss_set_stable(ss, true, 32);
+	for (uint32_t i = 0; i < 32; i++) ecs_ss_emplace(ss, ecs_id(i), &slot);
+	void* first = ecs_ss_get(ss, ecs_id(0)).data;
+	ecs_id_t erased[] = { ecs_id(3), ecs_id(9), ecs_id(17), ecs_id(30) };
+	ecs_id_t added[] = { ecs_id(40), ecs_id(41), ecs_id(42), ecs_id(43) };
+	ecs_ss_erase_n(ss, erased, 4);
+	ecs_ss_emplace_n(ss, added, 4, NULL, 0);
+	stable = stable && ecs_ss_get(ss, ecs_id(0)).data == first && ecs_ss_count(ss) == 32;
+	ecs_ss_destroy(ss);
+
+	test_debugf("Stable pool :: pointers %s | hole %s | compaction %s",
+		stable ? "kept" : "MOVED", reused ? "reused" : "NOT reused", compacted ? "OK" : "FAILED");
+	return (stable && reused && compacted) ? 0 : 1;
+}
+
+int ecs_ss_transient_test() {
+	ecs_ss_t* ss = ecs_ss_create(sizeof(MeshRenderer), 100, 32);
+	ecs_ss_set_transient(ss, true);
+	ecs_ss_slot_t slot;
+	bool valid = true;
+	for (uint32_t frame = 0; frame < 3; frame++) {
+		for (uint32_t i = frame; i < 10; i += 2) {
+			ecs_ss_emplace(ss, ecs_id(i), &slot);
+		}
+		for (uint32_t i = 0; i < 10; i++) {
+			bool expected = (i >= frame) && ((i - frame) % 2 == 0);
+			valid = valid && ecs_ss_has(ss, ecs_id(i)) == expected;
+		}
+		ecs_ss_clear(ss);
+		valid = valid && ecs_ss_count(ss) == 0 && !ecs_ss_has(ss, ecs_id(frame));
+	}
+	test_debugf("Transient pool :: %s", valid ? "OK" : "FAILED");
+	ecs_ss_destroy(ss);
+	return valid ? 0 : 1;
+}
+
 int ecs_test() {
 	bool success;
 	ecs_registry_t* reg = ecs_init();
@@ -75,10 +195,427 @@ int ecs_test() {
 	return 0;
 }
 
+int ecs_bulk_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+
+	const uint32_t count = 2000;
+	ecs_id_t first = ecs_new_entity(reg);
+	for (uint32_t i = 1; i < count; i++) ecs_new_entity(reg);
+	MeshRenderer bullet = { ecs_id(42), ecs_id(7), 1 };
+	int res = ecs_add_component_range(reg, first, count, hash32_id("MeshRenderer"), &bullet, 0);
+
+	ecs_id_t odd[count / 2];
+	for (uint32_t i = 0; i < count / 2; i++) odd[i] = ecs_id(first.id + 2 * i + 1);
+	if (ECS_OK == res) res = ecs_remove_component_n(reg, odd, count / 2, hash32_id("MeshRenderer"));
+
+	ecs_ss_t* pool = ecs_component_storage(reg, hash32_id("MeshRenderer"));
+	bool valid = true;
+	for (uint32_t i = 0; i < count; i++) {
+		MeshRenderer* mr = ecs_get_component(reg, ecs_id(first.id + i), hash32_id("MeshRenderer"));
+		valid = valid && ((i % 2) ? mr == NULL : (mr && mr->meshId.id == 42 && mr->flags == 1));
+	}
+	for (uint32_t i = 0; pool && i < count / 2; i++) {
+		valid = valid && ecs_ss_get(pool, ecs_ss_getid(pool, i)).data == ecs_ss_getslot(pool, i).data;
+	}
+	test_debugf("Bulk add/remove %s :: %s", ECS_OK == res ? "OK" : "FAILED", valid ? "consistent" : "NOT consistent");
+
+	ecs_cleanup(reg);
+	return (ECS_OK == res && valid) ? 0 : 1;
+}
+
+int ecs_prefab_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_register_component(reg, sizeof(HUDElement), hash32_id("HUDElement"), 64);
+
+	ecs_prefab_t* prefab = ecs_prefab_create(reg);
+	ecs_prefab_set_component(prefab, hash32_id("MeshRenderer"), &(MeshRenderer) { ecs_id(5), ecs_id(6), 0 });
+	ecs_prefab_set_component(prefab, hash32_id("HUDElement"), &(HUDElement) { ecs_id(9), "unit" });
+
+	const uint32_t count = 500;
+	ecs_id_t first = ecs_prefab_instantiate(prefab, count);
+	bool valid = ECS_NULL != first.id;
+	for (uint32_t i = 0; valid && i < count; i++) {
+		MeshRenderer* mr = ecs_get_component(reg, ecs_id(first.id + i), hash32_id("MeshRenderer"));
+		HUDElement* hud = ecs_get_component(reg, ecs_id(first.id + i), hash32_id("HUDElement"));
+		valid = mr && hud && mr->materialId.id == 6 && hud->fontId.id == 9;
+	}
+	test_debugf("Prefab instantiated %u entities from %u :: %s", count, first.id, valid ? "OK" : "FAILED");
+
+	ecs_prefab_destroy(prefab);
+	ecs_cleanup(reg);
+	return valid ? 0 : 1;
+}
+
+typedef struct Transform {
+	float position[3];
+	uint32_t flags;
+} Transform;
+
+int ecs_spatial_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(Transform), hash32_id("Transform"), 128);
+	ecs_spatial_t* sp = ecs_spatial_create(reg, hash32_id("Transform"), 0, 4.0f);
+
+	const uint32_t count = 100;
+	ecs_id_t first = ecs_new_entity_range(reg, count);
+	for (uint32_t i = 0; i < count; i++) {
+		Transform* t = ecs_add_component(reg, ecs_id(first.id + i), hash32_id("Transform"));
+		*t = (Transform) { { (float)(i % 10) * 3.0f, (float)(i / 10) * 3.0f, 0.0f }, 0 };
+	}
+	ecs_spatial_update(sp);
+
+	ecs_id_t out[count];
+	uint32_t in_box = ecs_spatial_query_box(sp, (float[3]) { -1, -1, -1 }, (float[3]) { 7, 7, 1 }, out, count);
+	uint32_t in_radius = ecs_spatial_query_radius(sp, (float[3]) { 0, 0, 0 }, 3.5f, out, count);
+	uint32_t nearest = ecs_spatial_query_nearest(sp, (float[3]) { 27, 27, 0 }, 1, out);
+	bool valid = in_box == 9 && in_radius == 3 && nearest == 1 && out[0].id == first.id + 99;
+
+	/* move the far corner next to the origin, then remove an entity in range */
+	Transform* t = ecs_get_component(reg, ecs_id(first.id + 99), hash32_id("Transform"));
+	t->position[0] = t->position[1] = 1.0f;
+	ecs_spatial_touch(sp, ecs_id(first.id + 99));
+	ecs_remove_component_n(reg, &first, 1, hash32_id("Transform"));
+	ecs_spatial_update(sp);
+	in_radius = ecs_spatial_query_radius(sp, (float[3]) { 0, 0, 0 }, 3.5f, out, count);
+	valid = valid && in_radius == 3;
+
+	/* a snapshot restore rewrites the pool behind the hooks, the index must follow */
+	ecs_snapshot_t* snap = ecs_snapshot_create(reg, 2);
+	ecs_snapshot_save(snap);
+	ecs_id_t moved = ecs_id(first.id + 99);
+	ecs_remove_component_n(reg, &moved, 1, hash32_id("Transform"));
+	ecs_spatial_update(sp);
+	valid = valid && ecs_spatial_query_radius(sp, (float[3]) { 0, 0, 0 }, 3.5f, out, count) == 2;
+	valid = valid && ECS_OK == ecs_snapshot_restore(snap, 0);
+	in_radius = ecs_spatial_query_radius(sp, (float[3]) { 0, 0, 0 }, 3.5f, out, count);
+	valid = valid && in_radius == 3;
+	ecs_snapshot_destroy(snap);
+
+	test_debugf("Spatial index :: box %u | radius %u | nearest %u :: %s", in_box, in_radius, nearest, valid ? "OK" : "FAILED");
+	ecs_spatial_destroy(sp);
+	ecs_cleanup(reg);
+	return valid ? 0 : 1;
+}
+
+typedef struct Time {
+	float dt;
+	uint32_t frame;
+} Time;
+
+static ecs_resource_t time_handle;
+static uint32_t time_system_calls;
+
+void time_system(ecs_registry_t* reg, ecs_id_t entity, uint32_t ncomps, ecs_id_t* comps) {
+	(void)entity; (void)ncomps; (void)comps;
+	Time* time = ecs_resource_ptr(reg, time_handle);
+	MeshRenderer* mr = ecs_get_component(reg, entity, hash32_id("MeshRenderer"));
+	mr->flags = time->frame;
+	time_system_calls++;
+}
+
+int ecs_resource_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	bool success = ecs_register_resource(reg, sizeof(Time), hash32_id("Time"), &(Time) { 1.0f / 60.0f, 7 });
+	bool clash = ecs_register_resource(reg, sizeof(Time), hash32_id("MeshRenderer"), NULL);
+	time_handle = ecs_resource_handle(reg, hash32_id("Time"));
+
+	ecs_id_t first = ecs_new_entity_range(reg, 3);
+	ecs_add_component_range(reg, first, 3, hash32_id("MeshRenderer"), NULL, 0);
+	ecs_system(reg, time_system, 2, hash32_id("MeshRenderer"), hash32_id("Time"));
+
+	Time* time = ecs_get_resource(reg, hash32_id("Time"));
+	MeshRenderer* mr = ecs_get_component(reg, first, hash32_id("MeshRenderer"));
+	bool valid = success && !clash && time && time->frame == 7 && time_system_calls == 3 && mr->flags == 7;
+	test_debugf("Resource 'Time' %s registered :: system calls %u :: %s", success ? "successfully" : "NOT", time_system_calls, valid ? "OK" : "FAILED");
+
+	ecs_cleanup(reg);
+	return valid ? 0 : 1;
+}
+
+typedef struct DamageEvent {
+	ecs_id_t target;
+	float amount;
+} DamageEvent;
+
+int ecs_event_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_event(reg, sizeof(DamageEvent), hash32_id("DamageEvent"), 16);
+	ecs_events_t* damage = ecs_event_channel(reg, hash32_id("DamageEvent"));
+
+	for (uint32_t i = 0; i < 10; i++) {
+		ecs_events_send(damage, &(DamageEvent) { ecs_id(i), 5.0f });
+	}
+	DamageEvent* batch = ecs_events_emit(damage, 6);
+	for (uint32_t i = 0; batch && i < 6; i++) batch[i] = (DamageEvent) { ecs_id(100 + i), 1.0f };
+	bool overflow = ecs_events_send(damage, &(DamageEvent) { ecs_id(0), 0.0f });
+
+	uint32_t before_swap;
+	ecs_events_read(damage, &before_swap);
+	ecs_swap_events(reg);
+	uint32_t count;
+	const DamageEvent* events = ecs_events_read(damage, &count);
+	bool valid = before_swap == 0 && !overflow && count == 16 && events[3].target.id == 3 && events[15].target.id == 105;
+	ecs_swap_events(reg);
+	ecs_events_read(damage, &count);
+	valid = valid && count == 0;
+	test_debugf("Events :: %s", valid ? "OK" : "FAILED");
+
+	ecs_cleanup(reg);
+	return valid ? 0 : 1;
+}
+
+int ecs_snapshot_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_snapshot_t* snap = ecs_snapshot_create(reg, 8);
+
+	ecs_id_t entity = ecs_new_entity(reg);
+	{
+		MeshRenderer* mr = (MeshRenderer*)ecs_add_component(reg, entity, hash32_id("MeshRenderer"));
+		*mr = (MeshRenderer) { ecs_id(1), ecs_id(2), 0 };
+	}
+	ecs_snapshot_save(snap); /* frame 0 */
+	for (uint32_t frame = 1; frame < 4; frame++) {
+		MeshRenderer* mr = (MeshRenderer*)ecs_get_component(reg, entity, hash32_id("MeshRenderer"));
+		mr->flags = frame;
+		ecs_id_t spawned = ecs_new_entity(reg);
+		ecs_add_component(reg, spawned, hash32_id("MeshRenderer"));
+		ecs_snapshot_save(snap);
+	}
+	test_debugf("Snapshot frames saved : %u", ecs_snapshot_count(snap));
+
+	int res = ecs_snapshot_restore(snap, 2); /* back to frame 1 */
+	{
+		MeshRenderer* mr = (MeshRenderer*)ecs_get_component(reg, entity, hash32_id("MeshRenderer"));
+		ecs_ss_t* pool = ecs_component_storage(reg, hash32_id("MeshRenderer"));
+		bool spawned = ecs_has_component(reg, ecs_id(2), hash32_id("MeshRenderer"));
+		test_debugf("Restore %s :: flags : %u | entity 1 : %s | entity 2 : %s | frames : %u",
+			ECS_OK == res ? "OK" : "FAILED", mr->flags,
+			ecs_ss_has(pool, ecs_id(1)) ? "present" : "missing",
+			spawned ? "present" : "missing", ecs_snapshot_count(snap));
+		if (mr->flags != 1 || spawned) {
+			res = ECS_ERROR;
+		}
+	}
+
+	// a wave spawn grows the pool and a new component is registered, rollback must still reach past both
+	ecs_id_t wave = ecs_new_entity_range(reg, 200);
+	ecs_add_component_range(reg, wave, 200, hash32_id("MeshRenderer"), NULL, 0);
+	ecs_register_component(reg, sizeof(HUDElement), hash32_id("HUDElement"), 64);
+	ecs_add_component(reg, entity, hash32_id("HUDElement"));
+	ecs_snapshot_save(snap);
+	bool kept = ecs_snapshot_count(snap) == 3 && ECS_OK == ecs_snapshot_restore(snap, 2); /* back to frame 0 */
+	kept = kept && ecs_ss_count(ecs_component_storage(reg, hash32_id("MeshRenderer"))) == 1;
+	kept = kept && !ecs_has_component(reg, ecs_id(wave.id + 199), hash32_id("MeshRenderer"));
+	kept = kept && !ecs_has_component(reg, entity, hash32_id("HUDElement"));
+	kept = kept && ((MeshRenderer*)ecs_get_component(reg, entity, hash32_id("MeshRenderer")))->flags == 0;
+	test_debugf("Restore across pool growth :: %s", kept ? "OK" : "FAILED");
+	if (!kept) {
+		res = ECS_ERROR;
+	}
+
+	// a large reserve with few live entities, pools shrink between saves and must come back whole
+	ecs_reserve_component(reg, hash32_id("MeshRenderer"), 1 << 18, 1 << 18);
+	ecs_id_t few = ecs_new_entity_range(reg, 8);
+	for (uint32_t i = 0; i < 8; i++) {
+		MeshRenderer* mr = (MeshRenderer*)ecs_add_component(reg, ecs_id(few.id + i), hash32_id("MeshRenderer"));
+		mr->meshId = ecs_id(100 + i);
+	}
+	ecs_snapshot_save(snap);
+	ecs_remove_component_range(reg, few, 6, hash32_id("MeshRenderer"));
+	ecs_snapshot_save(snap);
+	ecs_remove_component_range(reg, ecs_id(few.id + 6), 2, hash32_id("MeshRenderer"));
+	ecs_snapshot_save(snap);
+	kept = ECS_OK == ecs_snapshot_restore(snap, 2);
+	for (uint32_t i = 0; i < 8 && kept; i++) {
+		MeshRenderer* mr = (MeshRenderer*)ecs_get_component(reg, ecs_id(few.id + i), hash32_id("MeshRenderer"));
+		kept = mr && mr->meshId.id == 100 + i;
+	}
+	kept = kept && ecs_ss_count(ecs_component_storage(reg, hash32_id("MeshRenderer"))) == 9;
+	test_debugf("Restore with a large reserve :: %s", kept ? "OK" : "FAILED");
+	if (!kept) {
+		res = ECS_ERROR;
+	}
+
+	ecs_snapshot_destroy(snap);
+	ecs_cleanup(reg);
+	return res == ECS_OK ? 0 : 1;
+}
+
+int ecs_migrate_test() {
+	ecs_registry_t* zone_a = ecs_init();
+	ecs_registry_t* zone_b = ecs_init();
+	ecs_register_component(zone_a, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_register_component(zone_a, sizeof(HUDElement), hash32_id("HUDElement"), 64);
+	ecs_register_component(zone_b, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_new_entity(zone_b); // so ids differ between the zones
+
+	for (uint32_t i = 0; i < 10; i++) {
+		ecs_id_t entity = ecs_new_entity(zone_a);
+		MeshRenderer* mr = ecs_add_component(zone_a, entity, hash32_id("MeshRenderer"));
+		*mr = (MeshRenderer) { ecs_id(100 + i), ecs_id(i), 0 };
+		if (i % 3 == 0) {
+			HUDElement* hud = ecs_add_component(zone_a, entity, hash32_id("HUDElement"));
+			*hud = (HUDElement) { ecs_id(i), "crossing" };
+		}
+	}
+
+	ecs_ss_set_transient(ecs_component_storage(zone_a, hash32_id("HUDElement")), true);
+
+	// a batch without HUDElement must not create the pool in dst
+	ecs_id_t plain[] = { ecs_id(4) };
+	ecs_id_t moved = ecs_migrate_entities(zone_b, zone_a, plain, 1);
+	bool valid = moved.id == 1 && ecs_component_storage(zone_b, hash32_id("HUDElement")) == NULL;
+
+	// a pool that can't take the slots fails the whole batch and leaves dst as it was
+	ecs_registry_t* zone_c = ecs_init();
+	ecs_register_component(zone_c, sizeof(uint32_t), hash32_id("HUDElement"), 64);
+	ecs_id_t refused[] = { ecs_id(3) };
+	valid = valid && ecs_migrate_entities(zone_c, zone_a, refused, 1).id == ECS_NULL;
+	valid = valid && ecs_component_storage(zone_c, hash32_id("MeshRenderer")) == NULL;
+	valid = valid && ecs_has_component(zone_a, ecs_id(3), hash32_id("MeshRenderer"));
+	valid = valid && ecs_has_component(zone_a, ecs_id(3), hash32_id("HUDElement"));
+	valid = valid && ecs_register_component(zone_c, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_cleanup(zone_c);
+
+	// a repeated id or an empty batch is refused before anything is copied
+	ecs_id_t twice[] = { ecs_id(5), ecs_id(5) };
+	valid = valid && ecs_migrate_entities(zone_b, zone_a, twice, 2).id == ECS_NULL;
+	valid = valid && ecs_migrate_entities(zone_b, zone_a, twice, 0).id == ECS_NULL;
+	valid = valid && ecs_ss_count(ecs_component_storage(zone_b, hash32_id("MeshRenderer"))) == 1;
+
+	ecs_id_t leaving[] = { ecs_id(3), ecs_id(5), ecs_id(9) };
+	ecs_id_t first = ecs_migrate_entities(zone_b, zone_a, leaving, 3);
+	valid = valid && first.id == 2;
+	for (uint32_t i = 0; valid && i < 3; i++) {
+		MeshRenderer* mr = ecs_get_component(zone_b, ecs_id(first.id + i), hash32_id("MeshRenderer"));
+		HUDElement* hud = ecs_get_component(zone_b, ecs_id(first.id + i), hash32_id("HUDElement"));
+		valid = mr && mr->meshId.id == 100 + leaving[i].id;
+		valid = valid && ((leaving[i].id % 3 == 0) ? (hud && hud->fontId.id == leaving[i].id) : hud == NULL);
+		valid = valid && !ecs_has_component(zone_a, leaving[i], hash32_id("MeshRenderer"));
+		valid = valid && !ecs_has_component(zone_a, leaving[i], hash32_id("HUDElement"));
+	}
+	valid = valid && ecs_ss_count(ecs_component_storage(zone_a, hash32_id("MeshRenderer"))) == 6;
+	valid = valid && ecs_ss_count(ecs_component_storage(zone_a, hash32_id("HUDElement"))) == 2;
+	// the pool created in dst is transient like its source
+	ecs_clear_transient(zone_b);
+	valid = valid && ecs_ss_count(ecs_component_storage(zone_b, hash32_id("HUDElement"))) == 0;
+	test_debugf("Migrate entities between zones :: %s", valid ? "OK" : "FAILED");
+
+	ecs_cleanup(zone_a);
+	ecs_cleanup(zone_b);
+	return valid ? 0 : 1;
+}
+
+#define SPAWN_THREADS 4
+#define SPAWN_PER_THREAD 500
+
+static void* ecs_spawn_job(void* arg) {
+	ecs_registry_t* reg = arg;
+	for (uint32_t i = 0; i < SPAWN_PER_THREAD; i++) {
+		ecs_id_t entity = ecs_new_entity(reg);
+		MeshRenderer* mr = ecs_add_component_concurrent(reg, entity, hash32_id("MeshRenderer"));
+		if (mr) *mr = (MeshRenderer) { entity, ecs_id(1), 0 };
+		// every job races to add the same shared entity, only one may win
+		ecs_add_component_concurrent(reg, ecs_id(0), hash32_id("HUDElement"));
+	}
+	return NULL;
+}
+
+typedef struct RespawnJob {
+	ecs_registry_t* reg;
+	const ecs_id_t* ids;
+	uint32_t 		count;
+	uint32_t 		start;
+} RespawnJob;
+
+static void* ecs_respawn_job(void* arg) {
+	RespawnJob* job = arg;
+	for (uint32_t i = job->start; i < job->count; i += SPAWN_THREADS) {
+		MeshRenderer* mr = ecs_add_component_concurrent(job->reg, job->ids[i], hash32_id("MeshRenderer"));
+		if (mr) *mr = (MeshRenderer) { job->ids[i], ecs_id(2), 0 };
+	}
+	return NULL;
+}
+
+int ecs_concurrent_test() {
+	ecs_registry_t* reg = ecs_init();
+	ecs_register_component(reg, sizeof(MeshRenderer), hash32_id("MeshRenderer"), 64);
+	ecs_register_component(reg, sizeof(HUDElement), hash32_id("HUDElement"), 64);
+	const uint32_t count = SPAWN_THREADS * SPAWN_PER_THREAD;
+	ecs_reserve_component(reg, hash32_id("MeshRenderer"), count, count);
+	ecs_ss_set_concurrent(ecs_component_storage(reg, hash32_id("MeshRenderer")), true);
+	ecs_ss_set_concurrent(ecs_component_storage(reg, hash32_id("HUDElement")), true);
+
+	pthread_t threads[SPAWN_THREADS];
+	for (uint32_t i = 0; i < SPAWN_THREADS; i++) pthread_create(&threads[i], NULL, ecs_spawn_job, reg);
+	for (uint32_t i = 0; i < SPAWN_THREADS; i++) pthread_join(threads[i], NULL);
+
+	bool valid = ecs_new_entity(reg).id == count;
+	valid = valid && ecs_ss_count(ecs_component_storage(reg, hash32_id("MeshRenderer"))) == count;
+	valid = valid && ecs_ss_count(ecs_component_storage(reg, hash32_id("HUDElement"))) == 1;
+	for (uint32_t i = 0; i < count; i++) {
+		MeshRenderer* mr = ecs_get_component(reg, ecs_id(i), hash32_id("MeshRenderer"));
+		valid = valid && mr && mr->meshId.id == i;
+	}
+	test_debugf("Concurrent spawn of %u entities :: %s", count, valid ? "OK" : "FAILED");
+
+	// pop the last slots one by one, erase a batch from the middle, then add them all back concurrently
+	ecs_ss_t* pool = ecs_component_storage(reg, hash32_id("MeshRenderer"));
+	ecs_id_t removed[count];
+	uint32_t removed_count = 0;
+	for (uint32_t i = 0; i < count / 4; i++) {
+		removed[removed_count] = ecs_ss_getid(pool, ecs_ss_count(pool) - 1);
+		ecs_ss_erase(pool, removed[removed_count++]);
+	}
+	for (uint32_t i = 0; i < count / 4; i++) {
+		removed[removed_count++] = ecs_ss_getid(pool, 2 * i);
+	}
+	ecs_ss_erase_n(pool, removed + count / 4, count / 4);
+	// a concurrent add may reserve any of these slots before writing its id, none may still hold an old one
+	bool tail_clear = true;
+	for (uint32_t i = ecs_ss_count(pool); i < count; i++) {
+		tail_clear = tail_clear && ecs_ss_getid(pool, i).id == ECS_NULL;
+	}
+
+	pthread_t respawn[SPAWN_THREADS];
+	RespawnJob jobs[SPAWN_THREADS];
+	for (uint32_t i = 0; i < SPAWN_THREADS; i++) {
+		jobs[i] = (RespawnJob) { reg, removed, removed_count, i };
+		pthread_create(&respawn[i], NULL, ecs_respawn_job, &jobs[i]);
+	}
+	for (uint32_t i = 0; i < SPAWN_THREADS; i++) pthread_join(respawn[i], NULL);
+
+	bool respawned = tail_clear && ecs_ss_count(pool) == count;
+	for (uint32_t i = 0; i < removed_count; i++) {
+		MeshRenderer* mr = ecs_get_component(reg, removed[i], hash32_id("MeshRenderer"));
+		respawned = respawned && mr && mr->meshId.id == removed[i].id && mr->materialId.id == 2;
+	}
+	test_debugf("Concurrent respawn of %u removed entities :: %s", removed_count, respawned ? "OK" : "FAILED");
+	valid = valid && respawned;
+
+	ecs_cleanup(reg);
+	return valid ? 0 : 1;
+}
+
 int main() {
 	int res = 0;
-	res = ecs_ss_test();
-	res = ecs_test();
+	res |= ecs_ss_test();
+	res |= ecs_ss_sort_test();
+	res |= ecs_ss_stable_test();
+	res |= ecs_ss_transient_test();
+	res |= ecs_test();
+	res |= ecs_bulk_test();
+	res |= ecs_prefab_test();
+	res |= ecs_spatial_test();
+	res |= ecs_resource_test();
+	res |= ecs_event_test();
+	res |= ecs_snapshot_test();
+	res |= ecs_concurrent_test();
+	res |= ecs_migrate_test();
 	return res;
 }
 
@@ -99,19 +99,30 @@ hashmap_value_ptr hashmap_emplace(hashmap_t hashmap, hashmap_key_ptr key) {
 	uint32_t ideal_index = index;
 	hashmap_key_ptr pkey; hashmap_value_ptr pvalue;
 	getkv(hashmap, index, &pkey, &pvalue);
+	hashmap_key_ptr ptomb = NULL; hashmap_value_ptr ptombvalue = NULL;
 	hashmap_debugf("try insert @ %u", index);
-	while (!iskeyempty(hashmap, pkey) && !iskeytombstone(hashmap, pkey)) {
-		if (hashmap->keyeq_func(pkey, key)) {
+	while (!iskeyempty(hashmap, pkey)) {
+		if (iskeytombstone(hashmap, pkey)) {
+			// reusable, but the key may still sit further down the chain
+			if (!ptomb) { ptomb = pkey; ptombvalue = pvalue; }
+		}
+		else if (hashmap->keyeq_func(pkey, key)) {
 			hashmap_debugf("found existing @ %u", index);
 			return NULL;
 		}
 		index = (index + 1) % hashmap->bucket_count;
 		hashmap_debugf("try insert @ %u", index);
 		if (index == ideal_index) {
-			return NULL;
+			break;
 		}
 		getkv(hashmap, index, &pkey, &pvalue);
 	}
+	if (ptomb) {
+		pkey = ptomb; pvalue = ptombvalue;
+	}
+	else if (!iskeyempty(hashmap, pkey)) {
+		return NULL;
+	}
 	hashmap_debugf("inserted @ %u", index);
 	memcpy(pkey, key, hashmap->key_size);
 	return pvalue;
@@ -125,10 +136,7 @@ void* hashmap_find(hashmap_t hashmap, hashmap_key_ptr key) {
 	getkv(hashmap, index, &pkey, &pvalue);
 	while (!iskeyempty(hashmap, pkey)) {
 		hashmap_debugf("check key @ %u", index);
-		if (iskeytombstone(hashmap, pkey)) {
-			continue;
-		}
-		if (hashmap->keyeq_func(pkey, key)) {
+		if (!iskeytombstone(hashmap, pkey) && hashmap->keyeq_func(pkey, key)) {
 			hashmap_debugf("found key @ %u", index);
 			return pvalue;
 		}
@@ -148,10 +156,7 @@ bool hashmap_erase(hashmap_t hashmap, hashmap_key_ptr key, hashmap_value_ptr val
 	hashmap_key_ptr pkey; hashmap_value_ptr pvalue;
 	getkv(hashmap, index, &pkey, &pvalue);
 	while (!iskeyempty(hashmap, pkey)) {
-		if (iskeytombstone(hashmap, pkey)) {
-			continue;
-		}
-		if (hashmap->keyeq_func(pkey, key)) {
+		if (!iskeytombstone(hashmap, pkey) && hashmap->keyeq_func(pkey, key)) {
 			break;
 		}
 		index = (index + 1) % hashmap->bucket_count;
@@ -160,6 +165,9 @@ bool hashmap_erase(hashmap_t hashmap, hashmap_key_ptr key, hashmap_value_ptr val
 		}
 		getkv(hashmap, index, &pkey, &pvalue);
 	}
+	if (iskeyempty(hashmap, pkey)) {
+		return false;
+	}
 	memcpy(pkey, hashmap->buckets, hashmap->key_size);
 	if (value) {
 		memcpy(value, pvalue, hashmap->value_size);
@@ -170,6 +178,9 @@ bool hashmap_erase(hashmap_t hashmap, hashmap_key_ptr key, hashmap_value_ptr val
 
 uint32_t hashmap_iternext(hashmap_t hashmap, uint32_t index, hashmap_key_ptr* ppkey, hashmap_value_ptr* ppvalue) {
 	hashmap_key_ptr pkey; hashmap_value_ptr pvalue;
+	if (index >= hashmap->bucket_count) {
+		return -1;
+	}
 	getkv(hashmap, index, &pkey, &pvalue);
 	while (iskeyempty(hashmap, pkey) || iskeytombstone(hashmap, pkey)) {
 		index = index + 1;
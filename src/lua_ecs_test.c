@@ -2,7 +2,12 @@
 #include <lualib.h>
 #include <lauxlib.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "ecs.h"
 
@@ -14,6 +19,155 @@
 
 typedef struct ecs_entity_t ecs_entity_t;
 
+/* Native components are viewed from Lua through a pointer-sized userdata
+ * aimed straight at the slot in dense_slots, with one metatable per type
+ * whose __index/__newindex read and write fields by offset. The view is
+ * only valid while the pool isn't structurally modified, same as a C
+ * pointer into the pool. */
+typedef enum lua_ecs_field_type_t {
+	LUA_ECS_FLOAT,
+	LUA_ECS_DOUBLE,
+	LUA_ECS_INT32,
+	LUA_ECS_UINT32,
+	LUA_ECS_BOOL,
+} lua_ecs_field_type_t;
+
+typedef struct lua_ecs_field_t {
+	const char* 			name;
+	lua_ecs_field_type_t 	type;
+	uint32_t 				offset;
+} lua_ecs_field_t;
+
+#define LUA_ECS_FIELD(type, member, field_type) { #member, field_type, offsetof(type, member) }
+
+#define NATIVE_METATABLE_NAME_SIZE 128
+
+static void native_metatable_name(char* name, const char* id_str) {
+	snprintf(name, NATIVE_METATABLE_NAME_SIZE, "ecs.native.%s", id_str);
+}
+
+/* pushes the view metatable of a native component, returns false (and pushes nothing) if it has none */
+static bool push_native_metatable(lua_State* L, const char* id_str) {
+	char name[NATIVE_METATABLE_NAME_SIZE];
+	native_metatable_name(name, id_str);
+	if (luaL_getmetatable(L, name) == LUA_TNIL) {
+		lua_pop(L, 1);
+		return false;
+	}
+	return true;
+}
+
+static bool push_native_view(lua_State* L, const char* id_str, void* comp) {
+	void** view = (void**)lua_newuserdata(L, sizeof(void*));
+	*view = comp;
+	if (!push_native_metatable(L, id_str)) {
+		lua_pop(L, 1);
+		return false;
+	}
+	lua_setmetatable(L, -2);
+	return true;
+}
+
+int lua_ecs_native_index(lua_State* L) {
+	uint8_t* data = *(uint8_t**)lua_touserdata(L, 1);
+	lua_pushvalue(L, 2);
+	if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TNUMBER) {
+		return 1; /* nil */
+	}
+	lua_Integer desc = lua_tointeger(L, -1);
+	void* field = data + (desc >> 3);
+	switch ((lua_ecs_field_type_t)(desc & 7)) {
+		case LUA_ECS_FLOAT: 	lua_pushnumber(L, *(float*)field); break;
+		case LUA_ECS_DOUBLE: 	lua_pushnumber(L, *(double*)field); break;
+		case LUA_ECS_INT32: 	lua_pushinteger(L, *(int32_t*)field); break;
+		case LUA_ECS_UINT32: 	lua_pushinteger(L, *(uint32_t*)field); break;
+		case LUA_ECS_BOOL: 		lua_pushboolean(L, *(bool*)field); break;
+	}
+	return 1;
+}
+
+int lua_ecs_native_newindex(lua_State* L) {
+	uint8_t* data = *(uint8_t**)lua_touserdata(L, 1);
+	lua_pushvalue(L, 2);
+	if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TNUMBER) {
+		return luaL_error(L, "no field '%s' in native component", lua_tostring(L, 2));
+	}
+	lua_Integer desc = lua_tointeger(L, -1);
+	void* field = data + (desc >> 3);
+	switch ((lua_ecs_field_type_t)(desc & 7)) {
+		case LUA_ECS_FLOAT: 	*(float*)field = (float)luaL_checknumber(L, 3); break;
+		case LUA_ECS_DOUBLE: 	*(double*)field = luaL_checknumber(L, 3); break;
+		case LUA_ECS_INT32: 	*(int32_t*)field = (int32_t)luaL_checkinteger(L, 3); break;
+		case LUA_ECS_UINT32: 	*(uint32_t*)field = (uint32_t)luaL_checkinteger(L, 3); break;
+		case LUA_ECS_BOOL: 		*(bool*)field = lua_toboolean(L, 3); break;
+	}
+	return 0;
+}
+
+static void lua_ecs_workers_record_native(lua_State* L, ecs_id_t id);
+
+/* Registers the Lua view of a component registered from C. Must be called after lua_openecs. */
+void lua_ecs_register_native_component(lua_State* L, const char* id_str, const lua_ecs_field_t* fields, uint32_t nfields) {
+	char name[NATIVE_METATABLE_NAME_SIZE];
+	native_metatable_name(name, id_str);
+	luaL_newmetatable(L, name);
+	lua_createtable(L, 0, nfields); /* field -> offset << 3 | type */
+	for (uint32_t i = 0; i < nfields; i++) {
+		lua_pushinteger(L, ((lua_Integer)fields[i].offset << 3) | fields[i].type);
+		lua_setfield(L, -2, fields[i].name);
+	}
+	lua_pushvalue(L, -1);
+	lua_pushcclosure(L, lua_ecs_native_index, 1);
+	lua_setfield(L, -3, "__index");
+	lua_pushcclosure(L, lua_ecs_native_newindex, 1);
+	lua_setfield(L, -2, "__newindex");
+	lua_pop(L, 1);
+	lua_ecs_workers_record_native(L, hash32_id(id_str));
+}
+
+/* A worker state runs a slice of a Lua system on its own thread. Structural
+ * changes made from it are queued and applied on the calling thread once
+ * every worker has finished. */
+typedef struct lua_ecs_command_t {
+	ecs_id_t 	entity;
+	ecs_id_t 	component_id;
+} lua_ecs_command_t;
+
+typedef struct lua_ecs_workers_t lua_ecs_workers_t;
+
+typedef struct lua_ecs_worker_t {
+	lua_ecs_workers_t* 	owner;
+	lua_State* 			L;
+	pthread_t 			thread;
+	const char* 		system;			// global Lua function called per entity
+	const char* 		component;		// id string of the pool being walked
+	ecs_ss_t* 			pool;			// pool being walked
+	uint32_t 			begin, end;		// slot range of this worker
+	uint32_t 			command_count;
+	uint32_t 			command_capacity;
+	lua_ecs_command_t* 	commands;		// deferred AddComponent calls
+} lua_ecs_worker_t;
+
+/* Worker threads live as long as the pool. lua_ecs_workers_run bumps
+ * `generation` to hand out a batch and waits until `pending` drops to 0. */
+struct lua_ecs_workers_t {
+	ecs_registry_t* 	reg;
+	uint32_t 			count;
+	lua_ecs_worker_t* 	workers;
+	uint32_t 			thread_count;	// no. of threads started
+	pthread_mutex_t 	lock;
+	pthread_cond_t 		start;
+	pthread_cond_t 		done;
+	uint32_t 			generation;		// batch no., guarded by lock
+	uint32_t 			pending;		// workers still running the batch, guarded by lock
+	bool 				quit;
+	uint32_t 			native_count;
+	uint32_t 			native_capacity;
+	ecs_id_t* 			native_ids;		// components with a Lua view, the only ones workers may touch
+};
+
+typedef void (*pfn_lua_ecs_init_func)(lua_State* L);
+
 ecs_registry_t* get_ecs_registry_from_lua(lua_State* L) {
 	lua_getfield(L, LUA_REGISTRYINDEX, nameof(ecs_registry_t));
 	ecs_registry_t* reg = (ecs_registry_t*)lua_touserdata(L, -1);
@@ -21,6 +175,50 @@ ecs_registry_t* get_ecs_registry_from_lua(lua_State* L) {
 	return reg;
 }
 
+/* NULL unless L is a worker state */
+lua_ecs_worker_t* get_ecs_worker_from_lua(lua_State* L) {
+	lua_getfield(L, LUA_REGISTRYINDEX, nameof(lua_ecs_worker_t));
+	lua_ecs_worker_t* worker = (lua_ecs_worker_t*)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return worker;
+}
+
+/* NULL unless L belongs to a worker pool, set before the state's init runs */
+lua_ecs_workers_t* get_ecs_workers_from_lua(lua_State* L) {
+	lua_getfield(L, LUA_REGISTRYINDEX, nameof(lua_ecs_workers_t));
+	lua_ecs_workers_t* workers = (lua_ecs_workers_t*)lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	return workers;
+}
+
+static bool lua_ecs_workers_is_native(lua_ecs_workers_t* workers, ecs_id_t id) {
+	for (uint32_t i = 0; i < workers->native_count; i++) {
+		if (workers->native_ids[i].id == id.id) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Lua component tables only live in the main state, so workers tell native
+ * from Lua components by this list, kept on the C side of the pool. */
+static void lua_ecs_workers_record_native(lua_State* L, ecs_id_t id) {
+	lua_ecs_workers_t* workers = get_ecs_workers_from_lua(L);
+	if (!workers || lua_ecs_workers_is_native(workers, id)) {
+		return;
+	}
+	if (workers->native_count == workers->native_capacity) {
+		uint32_t capacity = workers->native_capacity ? 2 * workers->native_capacity : 16;
+		ecs_id_t* native_ids = realloc(workers->native_ids, sizeof(ecs_id_t) * capacity);
+		if (!native_ids) {
+			return;
+		}
+		workers->native_ids = native_ids;
+		workers->native_capacity = capacity;
+	}
+	workers->native_ids[workers->native_count++] = id;
+}
+
 int lua_ecs_RegisterComponent(lua_State* L) {
 	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
 	luaL_checktype(L, 1, LUA_TTABLE);
@@ -34,6 +232,9 @@ int lua_ecs_RegisterComponent(lua_State* L) {
 }
 
 int lua_ecs_CreateEntity(lua_State* L) {
+	if (get_ecs_worker_from_lua(L)) {
+		return luaL_error(L, "CreateEntity is not available to systems running on workers");
+	}
 	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
 	ecs_id_t entity = ecs_new_entity(reg);
 	ecs_id_t* lua_entity = (ecs_id_t*)lua_newuserdata(L, sizeof(ecs_id_t));
@@ -42,19 +243,46 @@ int lua_ecs_CreateEntity(lua_State* L) {
 	return 1;
 }
 
+static int lua_ecs_worker_defer_add(lua_State* L, lua_ecs_worker_t* worker, ecs_id_t entity, ecs_id_t id) {
+	if (!lua_ecs_workers_is_native(worker->owner, id)) {
+		return luaL_error(L, "only native components with a Lua view can be added from systems running on workers");
+	}
+	if (worker->command_count == worker->command_capacity) {
+		uint32_t capacity = worker->command_capacity ? 2 * worker->command_capacity : 64;
+		lua_ecs_command_t* commands = realloc(worker->commands, sizeof(lua_ecs_command_t) * capacity);
+		if (!commands) {
+			return luaL_error(L, "out of memory");
+		}
+		worker->commands = commands;
+		worker->command_capacity = capacity;
+	}
+	worker->commands[worker->command_count++] = (lua_ecs_command_t) { entity, id };
+	return 0;
+}
+
 int lua_ecs_entity_AddComponent(lua_State* L) {
 	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
 	ecs_id_t entity = *(ecs_id_t*)luaL_checkudata(L, 1, nameof(ecs_entity_t));
 	const char* id_str = luaL_checkstring(L, 2);
 	ecs_id_t id = hash32_id(id_str);
+	lua_ecs_worker_t* worker = get_ecs_worker_from_lua(L);
+	if (worker) {
+		return lua_ecs_worker_defer_add(L, worker, entity, id);
+	}
 	void* comp = ecs_add_component(reg, entity, id);
 	lua_debugf("reg: %p | entity: %u | id_str: %s | id: %u | comp: %p", reg, entity.id, id_str, id.id, comp);
 	int type = lua_rawget(L, LUA_REGISTRYINDEX);
 	lua_debugf("type: %s", lua_typename(L, type));
 	if (type == LUA_TNIL) { // Native component
 		lua_pop(L, 2);
-		// TODO: if there exists a metatable for the native type, then push comp as light user data with that metatable
 		assert(lua_gettop(L) == 0);
+		if (!comp) {
+			return 0;
+		}
+		memset(comp, 0, ecs_component_size(reg, id)); /* scripts can't construct native values, start them zeroed */
+		if (push_native_view(L, id_str, comp)) {
+			return 1;
+		}
 		return 0;
 	}
 	if (type == LUA_TTABLE) { // Lua component
@@ -70,6 +298,30 @@ int lua_ecs_entity_AddComponent(lua_State* L) {
 	return 1;
 }
 
+int lua_ecs_entity_GetComponent(lua_State* L) {
+	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
+	ecs_id_t entity = *(ecs_id_t*)luaL_checkudata(L, 1, nameof(ecs_entity_t));
+	const char* id_str = luaL_checkstring(L, 2);
+	lua_ecs_worker_t* worker = get_ecs_worker_from_lua(L);
+	if (worker && !lua_ecs_workers_is_native(worker->owner, hash32_id(id_str))) {
+		return luaL_error(L, "Lua components aren't visible to systems running on workers");
+	}
+	void* comp = ecs_get_component(reg, entity, hash32_id(id_str));
+	if (!comp) {
+		lua_pushnil(L);
+		return 1;
+	}
+	int type = worker ? LUA_TNIL : lua_rawget(L, LUA_REGISTRYINDEX);
+	if (type == LUA_TTABLE) { // Lua component
+		lua_rawgeti(L, LUA_REGISTRYINDEX, *(int*)comp);
+		return 1;
+	}
+	if (!push_native_view(L, id_str, comp)) {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+
 int lua_ecs_entity_HasComponent(lua_State* L) {
 	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
 	ecs_id_t entity = *(ecs_id_t*)luaL_checkudata(L, 1, nameof(ecs_entity_t));
@@ -89,17 +341,76 @@ int lua_ecs_entity_GetId(lua_State* L) {
 	return 1;
 }
 
+/* upvalues: pool, next index, reused entity, reused native view (or false for Lua components) */
+int lua_ecs_each_next(lua_State* L) {
+	ecs_ss_t* pool = (ecs_ss_t*)lua_touserdata(L, lua_upvalueindex(1));
+	uint32_t idx = (uint32_t)lua_tointeger(L, lua_upvalueindex(2));
+	uint32_t count = ecs_ss_count(pool);
+	while (idx < count && ECS_NULL == ecs_ss_getid(pool, idx).id) {
+		idx++; /* hole in a stable pool */
+	}
+	if (idx >= count) {
+		return 0;
+	}
+	lua_pushinteger(L, idx + 1);
+	lua_replace(L, lua_upvalueindex(2));
+	ecs_id_t* entity = (ecs_id_t*)lua_touserdata(L, lua_upvalueindex(3));
+	*entity = ecs_ss_getid(pool, idx);
+	void* comp = ecs_ss_getslot(pool, idx).data;
+	lua_pushvalue(L, lua_upvalueindex(3));
+	if (lua_isuserdata(L, lua_upvalueindex(4))) {
+		*(void**)lua_touserdata(L, lua_upvalueindex(4)) = comp;
+		lua_pushvalue(L, lua_upvalueindex(4));
+	}
+	else {
+		lua_rawgeti(L, LUA_REGISTRYINDEX, *(int*)comp);
+	}
+	return 2;
+}
+
+/* for entity, comp in ecs.Each "Position" do ... end
+ * The entity and native view are reused across steps, so they must not be kept past the loop body. */
+int lua_ecs_Each(lua_State* L) {
+	ecs_registry_t* reg = get_ecs_registry_from_lua(L);
+	const char* id_str = luaL_checkstring(L, 1);
+	ecs_ss_t* pool = ecs_component_storage(reg, hash32_id(id_str));
+	if (!pool) {
+		return luaL_error(L, "component '%s' is not registered", id_str);
+	}
+	lua_pushlightuserdata(L, pool);
+	lua_pushinteger(L, 0);
+	ecs_id_t* entity = (ecs_id_t*)lua_newuserdata(L, sizeof(ecs_id_t));
+	*entity = ECS_NULL_ID;
+	luaL_setmetatable(L, nameof(ecs_entity_t));
+	lua_ecs_worker_t* worker = get_ecs_worker_from_lua(L);
+	if (worker && !lua_ecs_workers_is_native(worker->owner, hash32_id(id_str))) {
+		return luaL_error(L, "Lua components aren't visible to systems running on workers");
+	}
+	lua_pushvalue(L, 1);
+	int type = worker ? LUA_TNIL : lua_rawget(L, LUA_REGISTRYINDEX);
+	lua_pop(L, 1);
+	if (type == LUA_TTABLE) { // Lua component
+		lua_pushboolean(L, false);
+	}
+	else if (!push_native_view(L, id_str, NULL)) {
+		return luaL_error(L, "native component '%s' has no Lua view", id_str);
+	}
+	lua_pushcclosure(L, lua_ecs_each_next, 4);
+	return 1;
+}
+
 int lua_openecs(lua_State* L) {
 	const luaL_Reg ecs_F[] = {
 		{ "RegisterComponent", lua_ecs_RegisterComponent },
 		{ "CreateEntity", lua_ecs_CreateEntity },
+		{ "Each", lua_ecs_Each },
 		{ NULL, NULL }
 	};
 	luaL_newlib(L, ecs_F); /* ecs = {} */
 
 	const luaL_Reg ecs_entity_M[] = {
 		{ "AddComponent", lua_ecs_entity_AddComponent },
-		// { "GetComponent", lua_ecs_entity_GetComponent },
+		{ "GetComponent", lua_ecs_entity_GetComponent },
 		{ "HasComponent", lua_ecs_entity_HasComponent },
 		{ "GetId", lua_ecs_entity_GetId },
 		{ NULL, NULL }
@@ -114,6 +425,209 @@ int lua_openecs(lua_State* L) {
 	return 1;
 }
 
+/********************************************************************/
+/* Worker states */
+
+static lua_State* lua_ecs_newstate_ex(ecs_registry_t* reg, lua_ecs_workers_t* workers, pfn_lua_ecs_init_func init) {
+	lua_State* L = luaL_newstate();
+	lua_pushstring(L, nameof(ecs_registry_t));
+	lua_pushlightuserdata(L, reg);
+	lua_rawset(L, LUA_REGISTRYINDEX);
+	if (workers) {
+		// before init, so native views registered there are recorded in the pool
+		lua_pushstring(L, nameof(lua_ecs_workers_t));
+		lua_pushlightuserdata(L, workers);
+		lua_rawset(L, LUA_REGISTRYINDEX);
+	}
+
+	luaL_openlibs(L);
+	luaL_requiref(L, "ecs", lua_openecs, true);
+	lua_pop(L, 1);
+	if (init) {
+		init(L);
+	}
+	return L;
+}
+
+lua_State* lua_ecs_newstate(ecs_registry_t* reg, pfn_lua_ecs_init_func init) {
+	return lua_ecs_newstate_ex(reg, NULL, init);
+}
+
+static void lua_ecs_worker_run_batch(lua_ecs_worker_t* worker) {
+	lua_State* L = worker->L;
+	int top = lua_gettop(L);
+	ecs_id_t* entity = (ecs_id_t*)lua_newuserdata(L, sizeof(ecs_id_t));
+	luaL_setmetatable(L, nameof(ecs_entity_t));
+	int entity_idx = lua_gettop(L);
+	if (!push_native_view(L, worker->component, NULL)) {
+		printf("[ERROR] <%s:%d> native component '%s' has no Lua view\n", __FUNCTION__, __LINE__, worker->component);
+		lua_settop(L, top);
+		return;
+	}
+	void** view = (void**)lua_touserdata(L, -1);
+	int view_idx = lua_gettop(L);
+	for (uint32_t idx = worker->begin; idx < worker->end; idx++) {
+		ecs_id_t id = ecs_ss_getid(worker->pool, idx);
+		if (ECS_NULL == id.id) {
+			continue; /* hole in a stable pool */
+		}
+		*entity = id;
+		*view = ecs_ss_getslot(worker->pool, idx).data;
+		lua_getglobal(L, worker->system);
+		lua_pushvalue(L, entity_idx);
+		lua_pushvalue(L, view_idx);
+		if (LUA_OK != lua_pcall(L, 2, 0, 0)) {
+			printf("[ERROR] <%s:%d> Lua error : %s\n", __FUNCTION__, __LINE__, lua_tostring(L, -1));
+			break;
+		}
+	}
+	lua_settop(L, top);
+}
+
+static void* lua_ecs_worker_main(void* arg) {
+	lua_ecs_worker_t* worker = (lua_ecs_worker_t*)arg;
+	lua_ecs_workers_t* workers = worker->owner;
+	uint32_t seen = 0;
+	pthread_mutex_lock(&workers->lock);
+	for (;;) {
+		while (!workers->quit && workers->generation == seen) {
+			pthread_cond_wait(&workers->start, &workers->lock);
+		}
+		if (workers->quit) {
+			break;
+		}
+		seen = workers->generation;
+		pthread_mutex_unlock(&workers->lock);
+		lua_ecs_worker_run_batch(worker);
+		pthread_mutex_lock(&workers->lock);
+		if (--workers->pending == 0) {
+			pthread_cond_signal(&workers->done);
+		}
+	}
+	pthread_mutex_unlock(&workers->lock);
+	return NULL;
+}
+
+void lua_ecs_workers_destroy(lua_ecs_workers_t* workers) {
+	pthread_mutex_lock(&workers->lock);
+	workers->quit = true;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+	for (uint32_t i = 0; i < workers->thread_count; i++) {
+		pthread_join(workers->workers[i].thread, NULL);
+	}
+	pthread_cond_destroy(&workers->done);
+	pthread_cond_destroy(&workers->start);
+	pthread_mutex_destroy(&workers->lock);
+	for (uint32_t i = 0; i < workers->count; i++) {
+		if (workers->workers[i].L) {
+			lua_close(workers->workers[i].L);
+		}
+		free(workers->workers[i].commands);
+	}
+	free(workers->workers);
+	free(workers->native_ids);
+	free(workers);
+}
+
+/* Every worker loads the same scripts, which should only define systems:
+ * anything they create at load time would be created once per worker.
+ * Returns NULL for count 0 or when a thread can't be started. */
+lua_ecs_workers_t* lua_ecs_workers_create(ecs_registry_t* reg, uint32_t count, pfn_lua_ecs_init_func init, const char** scripts, uint32_t nscripts) {
+	if (count == 0) {
+		return NULL;
+	}
+	lua_ecs_workers_t* workers = malloc(sizeof(lua_ecs_workers_t));
+	if (!workers) {
+		return NULL;
+	}
+	workers->reg = reg;
+	workers->count = count;
+	workers->workers = calloc(count, sizeof(lua_ecs_worker_t));
+	workers->thread_count = 0;
+	workers->generation = 0;
+	workers->pending = 0;
+	workers->quit = false;
+	workers->native_count = 0;
+	workers->native_capacity = 0;
+	workers->native_ids = NULL;
+	pthread_mutex_init(&workers->lock, NULL);
+	pthread_cond_init(&workers->start, NULL);
+	pthread_cond_init(&workers->done, NULL);
+	if (!workers->workers) {
+		workers->count = 0;
+		lua_ecs_workers_destroy(workers);
+		return NULL;
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		lua_ecs_worker_t* worker = &workers->workers[i];
+		worker->owner = workers;
+		worker->L = lua_ecs_newstate_ex(reg, workers, init);
+		for (uint32_t j = 0; j < nscripts; j++) {
+			if (LUA_OK != luaL_dofile(worker->L, scripts[j])) {
+				printf("[ERROR] <%s:%d> Lua error : %s\n", __FUNCTION__, __LINE__, lua_tostring(worker->L, -1));
+				lua_pop(worker->L, 1);
+			}
+		}
+		// set last, so scripts can still create entities while loading
+		lua_pushstring(worker->L, nameof(lua_ecs_worker_t));
+		lua_pushlightuserdata(worker->L, worker);
+		lua_rawset(worker->L, LUA_REGISTRYINDEX);
+	}
+	for (uint32_t i = 0; i < count; i++) {
+		int err = pthread_create(&workers->workers[i].thread, NULL, lua_ecs_worker_main, &workers->workers[i]);
+		if (err) {
+			printf("[ERROR] <%s:%d> can't start worker %u : %s\n", __FUNCTION__, __LINE__, i, strerror(err));
+			lua_ecs_workers_destroy(workers);
+			return NULL;
+		}
+		workers->thread_count++;
+	}
+	return workers;
+}
+
+/* Calls the global Lua function `system` as system(entity, comp) for every
+ * entity in the native pool `component`, split evenly across the workers.
+ * Systems may write native components in place; AddComponent calls are
+ * applied after all workers are done. */
+void lua_ecs_workers_run(lua_ecs_workers_t* workers, const char* system, const char* component) {
+	ecs_ss_t* pool = ecs_component_storage(workers->reg, hash32_id(component));
+	if (!pool) {
+		return;
+	}
+	uint32_t count = ecs_ss_count(pool);
+	uint32_t chunk = (count + workers->count - 1) / workers->count;
+	for (uint32_t i = 0; i < workers->count; i++) {
+		lua_ecs_worker_t* worker = &workers->workers[i];
+		worker->system = system;
+		worker->component = component;
+		worker->pool = pool;
+		worker->begin = (i * chunk < count) ? i * chunk : count;
+		worker->end = (worker->begin + chunk < count) ? worker->begin + chunk : count;
+		worker->command_count = 0;
+	}
+	pthread_mutex_lock(&workers->lock);
+	workers->pending = workers->count;
+	workers->generation++;
+	pthread_cond_broadcast(&workers->start);
+	while (workers->pending > 0) {
+		pthread_cond_wait(&workers->done, &workers->lock);
+	}
+	pthread_mutex_unlock(&workers->lock);
+	// applied in worker order, so the result doesn't depend on scheduling
+	for (uint32_t i = 0; i < workers->count; i++) {
+		lua_ecs_worker_t* worker = &workers->workers[i];
+		for (uint32_t j = 0; j < worker->command_count; j++) {
+			lua_ecs_command_t* cmd = &worker->commands[j];
+			void* comp = ecs_add_component(workers->reg, cmd->entity, cmd->component_id);
+			if (comp) {
+				memset(comp, 0, ecs_component_size(workers->reg, cmd->component_id));
+			}
+		}
+		worker->command_count = 0;
+	}
+}
+
 typedef struct { float x, y, z; } Vector3;
 
 #define LUA_CHECK(L, cmd) do { if (LUA_OK != (cmd)) { const char* _err = luaL_checkstring(L, -1); printf("[ERROR] <%s:%d> Lua error : %s\n", __FUNCTION__, __LINE__, _err); } } while (0)
@@ -141,22 +655,35 @@ void movement_system(ecs_registry_t* reg, ecs_id_t entity, uint32_t ncomps, ecs_
 	printf("[Position, Velocity] Entity: %u\n", entity.id);
 }
 
+void register_native_views(lua_State* L) {
+	const lua_ecs_field_t vector3_fields[] = {
+		LUA_ECS_FIELD(Vector3, x, LUA_ECS_FLOAT),
+		LUA_ECS_FIELD(Vector3, y, LUA_ECS_FLOAT),
+		LUA_ECS_FIELD(Vector3, z, LUA_ECS_FLOAT),
+	};
+	lua_ecs_register_native_component(L, "Position", vector3_fields, 3);
+	lua_ecs_register_native_component(L, "Velocity", vector3_fields, 3);
+}
+
 int main() {
 	ecs_registry_t* reg = ecs_init();
 
 	ecs_register_component(reg, sizeof(Vector3), hash32_id("Position"), DEFAULT_ECS_POOL_INIT_COUNT);
 	ecs_register_component(reg, sizeof(Vector3), hash32_id("Velocity"), DEFAULT_ECS_POOL_INIT_COUNT);
 
-	L = luaL_newstate();
-	lua_pushstring(L, nameof(ecs_registry_t));
-	lua_pushlightuserdata(L, reg);
-	lua_rawset(L, LUA_REGISTRYINDEX);
-
-	luaL_openlibs(L);
-	luaL_requiref(L, "ecs", lua_openecs, true);
+	L = lua_ecs_newstate(reg, register_native_views);
 
 	LUA_CHECK(L, luaL_dofile(L, "ecs_test.lua"));
 
+	{
+		const char* scripts[] = { "ecs_systems.lua" };
+		lua_ecs_workers_t* workers = lua_ecs_workers_create(reg, 4, register_native_views, scripts, 1);
+		if (workers) {
+			lua_ecs_workers_run(workers, "MoveSystem", "Velocity");
+			lua_ecs_workers_destroy(workers);
+		}
+	}
+
 	{
 		void* comp = ecs_component_storage(reg, hash32_id("Money"));
 		assert(comp != NULL);
@@ -168,7 +695,7 @@ int main() {
 	}
 
 	{
-		// ecs_iter_component(reg, hash("Position"), ecs_position_callback);
+		ecs_iter_component(reg, hash32_id("Position"), ecs_position_callback);
 		ecs_iter_component(reg, hash32_id("Money"), ecs_money_callback);
 	}
 